@@ -1,13 +1,29 @@
 #pragma once
 
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index_container.hpp>
-
-#include <map>
-#include <set>
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-namespace bmi = boost::multi_index;
+//  generic fallback, distance types with a cheaper way to find
+//  the highest set bit provide their own bucket_index overload
+template <class T_distance>
+size_t bucket_index(T_distance distance)
+{
+    T_distance const zero{};
+    T_distance two{};
+    ++two;
+    ++two;
+
+    size_t cnt{};
+    for( ; distance > zero; distance /= two, ++cnt);
+    return --cnt;
+}
 
 template<class T_Contact>
 struct contact_actions
@@ -29,11 +45,9 @@ struct contact_actions
         return distance(a, b) == zero(); 
     }
 
-    static index_type index_from_distance(distance_type distance)
+    static index_type index_from_distance(distance_type const& distance)
     {
-        index_type cnt{};
-        for( ; distance > zero(); distance /= two(), ++cnt);
-        return --cnt;
+        return bucket_index(distance);
     }
 
     static index_type index(const T_Contact& a, const T_Contact& b)
@@ -42,68 +56,103 @@ struct contact_actions
     }
 };
 
+//  contacts are kept in LEVELS fixed buckets by the index of their
+//  distance from origin, each bucket holds up to K contacts,
+//  a hash index from node id to bucket makes find() and erase() O(K)
+//  each bucket is ordered least recently seen first, and has a
+//  replacement cache of up to K contacts that did not fit in it
 template <class T_Contact, int K = 20>
 class KBucket
 {
     using actions = contact_actions<T_Contact>;
     using index_type = typename actions::index_type;
     using distance_type = typename actions::distance_type;
+    using node_id_type = typename T_Contact::node_id_type;
+
+public:
+    enum { LEVELS = 256 };
 
-    struct by_index {};
-    struct by_distance {};
+private:
+    using bucket_type = std::vector<T_Contact>;
+    using buckets_type = std::array<bucket_type, LEVELS>;
 
-    struct rel_index
+public:
+    class iterator : public std::iterator<std::forward_iterator_tag, T_Contact const>
     {
-        rel_index(T_Contact const& origin) : _origin{ origin } {}
-
-        bool operator ()(T_Contact const& a, T_Contact const& b) const
+    public:
+        iterator(buckets_type const* buckets_ = nullptr,
+                 size_t level_ = LEVELS,
+                 size_t position_ = 0)
+            : buckets(buckets_)
+            , level(level_)
+            , position(position_)
         {
-            auto const& index_a = actions::index(_origin, a);
-            auto const& index_b = actions::index(_origin, b);
-
-            return index_a < index_b;
+            skip_empty();
         }
 
-    private:
-        T_Contact _origin;
-    };
-
-    struct rel_distance
-    {
-        rel_distance(T_Contact const& origin): _origin{ origin } {}
+        T_Contact const& operator*() const { return (*buckets)[level][position]; }
+        T_Contact const* operator->() const { return &(*buckets)[level][position]; }
 
-        bool operator()(T_Contact const& a, T_Contact const& b) const
+        iterator& operator++()
+        {
+            ++position;
+            skip_empty();
+            return *this;
+        }
+        iterator operator++(int)
         {
-            auto const& dist_a = actions::distance(_origin, a);
-            auto const& dist_b = actions::distance(_origin, b);
+            iterator result = *this;
+            ++*this;
+            return result;
+        }
 
-            return dist_a < dist_b;
+        bool operator==(iterator const& other) const
+        {
+            return level == other.level && position == other.position;
+        }
+        bool operator!=(iterator const& other) const
+        {
+            return false == (*this == other);
         }
 
     private:
-        T_Contact _origin;
-    };
+        friend class KBucket;
 
-    using ContactIndex = bmi::multi_index_container<T_Contact, bmi::indexed_by<
-        bmi::ordered_unique<bmi::tag<by_distance>, bmi::identity<T_Contact>, rel_distance >,
-        bmi::ordered_non_unique<bmi::tag<by_index>, bmi::identity<T_Contact>, rel_index > > >;
+        void skip_empty()
+        {
+            while (level < LEVELS &&
+                   position >= (*buckets)[level].size())
+            {
+                ++level;
+                position = 0;
+            }
+
+            if (level >= LEVELS)
+            {
+                level = LEVELS;
+                position = 0;
+            }
+        }
 
-public:
-    using iterator = typename ContactIndex::iterator;
-    using const_iterator = typename ContactIndex::const_iterator;
+        buckets_type const* buckets;
+        size_t level;
+        size_t position;
+    };
+    using const_iterator = iterator;
 
-    iterator end() const { return contacts.end(); }
-    iterator begin() const { return contacts.begin(); }
+    iterator end() const { return iterator(&buckets, LEVELS); }
+    iterator begin() const { return iterator(&buckets, 0); }
 
-    const_iterator cend() const { return contacts.cend(); }
-    const_iterator cbegin() const { return contacts.cbegin(); }
+    const_iterator cend() const { return end(); }
+    const_iterator cbegin() const { return begin(); }
 
     KBucket(T_Contact const& origin_ = {})
         : origin{ origin_ }
-        , contacts{boost::make_tuple(
-                   boost::make_tuple(bmi::identity<T_Contact>{}, rel_distance{ origin }),
-                   boost::make_tuple(bmi::identity<T_Contact>{}, rel_index{ origin })
-                   )}
+        , buckets()
+        , replacements()
+        , bucket_by_id()
+        , replacement_by_id()
+        , promoted()
     {}
 
     std::pair<iterator, bool> insert(T_Contact const& contact);
@@ -114,16 +163,32 @@ public:
 //    KBucket<T_Contact, K> rebase(T_Contact const& new_origin, bool include_origin = true) const;
 
     void clear()
-    { 
-        ContactIndex{boost::make_tuple(
-                        boost::make_tuple(bmi::identity<T_Contact>{}, rel_distance{ origin }),
-                        boost::make_tuple(bmi::identity<T_Contact>{}, rel_index{ origin })
-                        )}.swap(contacts); 
+    {
+        for (auto& bucket : buckets)
+            bucket.clear();
+        for (auto& cache : replacements)
+            cache.clear();
+        bucket_by_id.clear();
+        replacement_by_id.clear();
+        promoted.clear();
     }
 
+    //  moves the contact to the most recently seen end of its bucket
+    //  or replacement cache, returns false if it is in neither
+    bool touch(T_Contact const& contact);
+    //  keeps a contact that did not fit in its full bucket, it is
+    //  promoted into the bucket when a contact is erased from there
+    bool add_replacement(T_Contact const& contact);
+    bool is_replacement(T_Contact const& contact) const;
+    //  true if insert() would add the contact to its bucket
+    bool has_room_for(T_Contact const& contact) const;
+    //  contacts moved from replacement caches to buckets since last call
+    std::vector<T_Contact> take_promoted();
+
 //    bool replace(T_Contact const& contact);
     iterator find(T_Contact const& contact) const;
-//    std::vector<T_Contact> list_nearests_to(T_Contact const& contact, bool prefer_same_index = false) const;
+    //  at most count contacts, closest to the target first
+    std::vector<T_Contact> list_nearests_to(T_Contact const& target, size_t count = K) const;
 
     std::vector<std::string> get_nodeids() const;
 
@@ -131,8 +196,14 @@ public:
     void print_count(std::ostream& os);
 
 private:
+    static bool move_to_back(bucket_type& bucket, T_Contact const& contact);
+
     T_Contact origin;
-    ContactIndex contacts;
+    buckets_type buckets;
+    buckets_type replacements;
+    std::unordered_map<node_id_type, index_type> bucket_by_id;
+    std::unordered_map<node_id_type, index_type> replacement_by_id;
+    std::vector<T_Contact> promoted;
 };
 
 
@@ -147,7 +218,7 @@ private:
 //    if (include_origin)
 //        result.insert(this->origin);
 //
-//    for (auto const& it : contacts)
+//    for (auto const& it : *this)
 //    {
 //        if (!actions::is_same(it, new_origin))
 //            result.insert(it);
@@ -164,31 +235,69 @@ std::pair<typename KBucket<T_Contact, K>::iterator, bool> KBucket<T_Contact, K>:
         throw(std::logic_error{"Trying to insert contact with 0 distance from the origin, i.e. self"});
 
     auto index = actions::index_from_distance(distance);
+    if (index >= LEVELS)
+        throw(std::logic_error{"Contact distance does not fit in KBucket levels"});
 
-    auto eq_index = [&](const T_Contact& c) 
-    { 
-        return actions::index(origin, c) == index; 
-    };
+    auto it_find = find(contact);
+    if (it_find != end())
+        return {it_find, false};
 
-    auto const &contacts_by_index  = contacts.template get<by_index>();
-    auto index_count = std::count_if(std::begin(contacts_by_index), std::end(contacts_by_index), eq_index);
+    //  the least recently seen contact is returned when full
+    auto& bucket = buckets[index];
+    if (bucket.size() >= K)
+        return {iterator(&buckets, index, 0), false};
 
-    if (index_count >= K)
-        return {contacts.template project<by_distance>(std::find_if(std::begin(contacts_by_index), std::end(contacts_by_index), eq_index)), false};
+    bucket.push_back(contact);
+    bucket_by_id.insert({contact.get_id(), index});
 
-    return contacts.insert(contact);
+    return {iterator(&buckets, index, bucket.size() - 1), true};
 }
 
 template <class T_Contact, int K>
 typename KBucket<T_Contact, K>::iterator KBucket<T_Contact, K>::erase(iterator const& pos)
 {
-    return contacts.erase(pos);
+    auto& bucket = buckets[pos.level];
+
+    bucket_by_id.erase(bucket[pos.position].get_id());
+    bucket.erase(bucket.begin() + pos.position);
+
+    auto& cache = replacements[pos.level];
+    if (false == cache.empty())
+    {
+        //  the most recently seen replacement takes the free place
+        bucket.push_back(cache.back());
+        cache.pop_back();
+
+        replacement_by_id.erase(bucket.back().get_id());
+        bucket_by_id.insert({bucket.back().get_id(), pos.level});
+        promoted.push_back(bucket.back());
+    }
+
+    return iterator(&buckets, pos.level, pos.position);
 }
 
 template <class T_Contact, int K>
 typename KBucket<T_Contact, K>::iterator KBucket<T_Contact, K>::erase(iterator const& first, iterator const& last)
 {
-    return contacts.erase(first, last);
+    //  erase shifts the bucket and may promote a replacement to its end,
+    //  so the contacts are taken out first and erased one by one
+    std::vector<T_Contact> contacts(first, last);
+
+    bool last_is_end = (last == end());
+    T_Contact next;
+    if (false == last_is_end)
+        next = *last;
+
+    for (auto const& contact : contacts)
+    {
+        auto it = find(contact);
+        if (it != end())
+            erase(it);
+    }
+
+    if (last_is_end)
+        return end();
+    return find(next);
 }
 
 template <class T_Contact, int K>
@@ -197,59 +306,146 @@ typename KBucket<T_Contact, K>::iterator KBucket<T_Contact, K>::erase(T_Contact
     auto it = find(contact);
     
     if (it != end())
-        return contacts.erase(it);
+        return erase(it);
+
+    auto it_replacement = replacement_by_id.find(contact.get_id());
+    if (it_replacement != replacement_by_id.end())
+    {
+        auto& cache = replacements[it_replacement->second];
+        replacement_by_id.erase(it_replacement);
+
+        cache.erase(std::remove_if(cache.begin(), cache.end(),
+                                   [&contact](T_Contact const& item)
+                                   {
+                                       return item.get_id() == contact.get_id();
+                                   }),
+                    cache.end());
+    }
 
     return it;
 }
 
-//template< class T_SrcIt, class T_DstIt >
-//T_DstIt loop_copy(T_SrcIt pivot, T_SrcIt first, T_SrcIt last, T_DstIt d_first, T_DstIt d_last)
-//{
-//    for (auto it = pivot; it != last && d_first != d_last; ++it)
-//        *d_first++ = *it;
-//
-//    for (auto it = first; it != pivot && d_first != d_last; ++it)
-//        *d_first++ = *it;
-//
-//    return d_first;
-//}
+template <class T_Contact, int K>
+bool KBucket<T_Contact, K>::move_to_back(bucket_type& bucket, T_Contact const& contact)
+{
+    for (size_t position = 0; position < bucket.size(); ++position)
+    {
+        if (bucket[position].get_id() == contact.get_id())
+        {
+            std::rotate(bucket.begin() + position,
+                        bucket.begin() + position + 1,
+                        bucket.end());
+            return true;
+        }
+    }
 
-//template <class T_Contact, int K>
-//std::vector<T_Contact> KBucket<T_Contact, K>::list_nearests_to(const T_Contact& contact, bool prefer_same_index) const
-//{
-//    std::vector<T_Contact> result{ 10 * K };
-//
-//    auto& contacts_by_distance = contacts.template get<by_distance>();
-//
-//    auto it = std::begin(contacts_by_distance);
-//    if (prefer_same_index)
-//    {
-//        auto index_ = actions::index(origin, contact);
-//        it = std::find_if(std::begin(contacts_by_distance), std::end(contacts_by_distance),
-//                         [&](const T_Contact &a){ return index_ == actions::index(origin, a); } );
-//    }
-//
-//    auto result_end = loop_copy(it, 
-//                                std::begin(contacts_by_distance), 
-//                                std::end(contacts_by_distance),
-//                                std::begin(result), 
-//                                std::end(result));
-//
-//    result.erase(result_end, std::end(result));
-//
-//    return result;
-//}
+    return false;
+}
+
+template <class T_Contact, int K>
+bool KBucket<T_Contact, K>::touch(T_Contact const& contact)
+{
+    auto it_find = bucket_by_id.find(contact.get_id());
+    if (it_find != bucket_by_id.end())
+        return move_to_back(buckets[it_find->second], contact);
+
+    it_find = replacement_by_id.find(contact.get_id());
+    if (it_find != replacement_by_id.end())
+        return move_to_back(replacements[it_find->second], contact);
+
+    return false;
+}
+
+template <class T_Contact, int K>
+bool KBucket<T_Contact, K>::add_replacement(T_Contact const& contact)
+{
+    auto distance = actions::distance(origin, contact);
+    if (distance == actions::zero() ||
+        bucket_by_id.count(contact.get_id()))
+        return false;
+
+    if (touch(contact))
+        return true;
+
+    auto index = actions::index_from_distance(distance);
+    if (index >= LEVELS)
+        return false;
+
+    auto& cache = replacements[index];
+    if (cache.size() >= K)
+    {
+        replacement_by_id.erase(cache.front().get_id());
+        cache.erase(cache.begin());
+    }
+
+    cache.push_back(contact);
+    replacement_by_id.insert({contact.get_id(), index});
+
+    return true;
+}
+
+template <class T_Contact, int K>
+bool KBucket<T_Contact, K>::is_replacement(T_Contact const& contact) const
+{
+    return replacement_by_id.count(contact.get_id()) > 0;
+}
+
+template <class T_Contact, int K>
+bool KBucket<T_Contact, K>::has_room_for(T_Contact const& contact) const
+{
+    auto distance = actions::distance(origin, contact);
+    if (distance == actions::zero() ||
+        bucket_by_id.count(contact.get_id()))
+        return false;
+
+    auto index = actions::index_from_distance(distance);
+    if (index >= LEVELS)
+        return false;
+
+    return buckets[index].size() < K;
+}
+
+template <class T_Contact, int K>
+std::vector<T_Contact> KBucket<T_Contact, K>::take_promoted()
+{
+    std::vector<T_Contact> result;
+    result.swap(promoted);
+    return result;
+}
+
+template <class T_Contact, int K>
+std::vector<T_Contact> KBucket<T_Contact, K>::list_nearests_to(T_Contact const& target, size_t count) const
+{
+    using item_type = std::pair<distance_type, T_Contact const*>;
+    std::vector<item_type> items;
+    items.reserve(bucket_by_id.size());
+
+    for (auto const& contact : *this)
+        items.push_back(item_type(actions::distance(target, contact), &contact));
+
+    count = std::min(count, items.size());
+    std::partial_sort(items.begin(), items.begin() + count, items.end(),
+                      [](item_type const& a, item_type const& b)
+                      {
+                          return a.first < b.first;
+                      });
+
+    std::vector<T_Contact> result;
+    result.reserve(count);
+    for (size_t index = 0; index < count; ++index)
+        result.push_back(*items[index].second);
+
+    return result;
+}
 
 template <class T_Contact, int K>
 std::vector<std::string> KBucket<T_Contact, K>::get_nodeids() const
 {
     std::vector<std::string> result;
+    result.reserve(bucket_by_id.size());
 
-    auto& contacts_by_distance = contacts.template get<by_distance>();
-    
-    auto it = std::begin(contacts_by_distance);
-    for (; it != std::end(contacts_by_distance); ++it)
-        result.push_back(it->to_string());
+    for (auto const& contact : *this)
+        result.push_back(contact.to_string());
 
     return result;
 }
@@ -257,37 +453,36 @@ std::vector<std::string> KBucket<T_Contact, K>::get_nodeids() const
 template <class T_Contact, int K>
 void KBucket<T_Contact, K>::print_list(std::ostream& os)
 {
-    auto & contacts_by_distance = contacts.template get<by_distance>();
-    for(auto& it : contacts_by_distance)
-    {
-        auto const& distance = actions::distance(origin, it);
-        auto const& index = actions::index_from_distance(distance);
-        os<<"index: "<<index<<", id: "<<static_cast<std::string>(it).substr(0, 8) << std::endl;
-    };
+    for (size_t index = 0; index < LEVELS; ++index)
+    for (auto const& contact : buckets[index])
+        os<<"index: "<<index<<", id: "<<static_cast<std::string>(contact).substr(0, 8) << std::endl;
 }
 
 template <class T_Contact, int K>
 void KBucket<T_Contact, K>::print_count(std::ostream& os)
 {
-    std::map<size_t, std::set<std::string>> map_by_distance;
-
-    auto & contacts_by_distance = contacts.template get<by_distance>();
-    for(auto &it : contacts_by_distance)
+    for (size_t index = 0; index < LEVELS; ++index)
     {
-        auto const& distance = actions::distance(origin, it);
-        auto const& index = actions::index_from_distance(distance);
-
-        map_by_distance[index].insert(it);
-    };
-
-    for (auto const& it : map_by_distance)
-        os << "\nslot " << it.first << " : count " << it.second.size() << std::endl;
+        if (false == buckets[index].empty())
+            os << "\nslot " << index << " : count " << buckets[index].size() << std::endl;
+    }
 }
 
 template <class T_Contact, int K>
 typename KBucket<T_Contact, K>::iterator KBucket<T_Contact, K>::find(T_Contact const& contact) const
 {
-    return std::find_if(begin(), end(), [&contact](T_Contact const& c){ return actions::distance(contact, c) == actions::zero(); });
+    auto it_find = bucket_by_id.find(contact.get_id());
+    if (it_find == bucket_by_id.end())
+        return end();
+
+    auto const& bucket = buckets[it_find->second];
+    for (size_t position = 0; position < bucket.size(); ++position)
+    {
+        if (bucket[position].get_id() == contact.get_id())
+            return iterator(&buckets, it_find->second, position);
+    }
+
+    return end();
 }
 
 // template <class T_Contact, int K>
@@ -2,12 +2,17 @@
 
 #include <belt.pp/socket.hpp>
 
+#include <mesh.pp/cryptopp_byte.hpp>
+
 #include <cryptopp/integer.h>
 #include <cryptopp/hex.h>
 #include <cryptopp/sha.h>
 
+#include <array>
+#include <cstdint>
 #include <ctime>
 
+#include <iomanip>
 #include <sstream>
 #include <string>
 
@@ -43,9 +48,12 @@ protected:
 
 }
 
+//  256 bit value, words[0] holds the most significant bits
+//  nodeids are mapped to it through sha256 once per contact,
+//  distance between two of them is the bitwise xor
 struct string_distance
 {
-    using value_type = CryptoPP::Integer;
+    using value_type = std::array<uint64_t, 4>;
 
     string_distance(const std::string& str = {})
         : _val{}
@@ -53,61 +61,78 @@ struct string_distance
         if (str.empty())
             return;
 
-        CryptoPP::SHA256 hash;
-        CryptoPP::StringSource ss(str, true, new CryptoPP::HashFilter(hash));
-        _val.Decode(*ss.AttachedTransformation(), hash.DigestSize());
+        CryptoPP::byte digest[CryptoPP::SHA256::DIGESTSIZE];
+        CryptoPP::SHA256().CalculateDigest(digest,
+                                           reinterpret_cast<CryptoPP::byte const*>(str.data()),
+                                           str.size());
+
+        for (size_t word = 0; word < _val.size(); ++word)
+        for (size_t index = 0; index < sizeof(uint64_t); ++index)
+            _val[word] = (_val[word] << 8) | digest[word * sizeof(uint64_t) + index];
     }
 
     string_distance(value_type const& val)
-        :_val{val}
+        :_val(val)
     {}
 
+    value_type const& value() const { return _val; }
+
     bool operator<(string_distance const& r) const { return _val < r._val; }
     bool operator>(string_distance const& r) const { return _val > r._val; }
     bool operator==(string_distance const& r) const { return _val == r._val; }
     bool operator!=(string_distance const& r) const { return _val != r._val; }
-    void operator/=(string_distance const& r) { _val /= r._val; }
-    string_distance& operator++() { ++_val; return *this; }
     string_distance operator-(string_distance const& r) const
     {
-        if (this == &r || *this == r)
-        {
-            return string_distance{};
-        }
-        else
-        {
-            auto abs_a = _val.AbsoluteValue();
-            auto abs_b = r._val.AbsoluteValue();
-            value_type result = (abs_b > abs_a) ? abs_b : abs_a;
-
-            size_t size_a = abs_a.ByteCount();
-            size_t size_b = abs_b.ByteCount();
-            size_t size = std::max(size_a, size_b);
-            for (size_t index = 0; index < size; ++index)
-            {
-                unsigned char byte_a = 0, byte_b = 0;
+        value_type result;
+        for (size_t word = 0; word < result.size(); ++word)
+            result[word] = _val[word] ^ r._val[word];
 
-                if (index <= size_a)
-                    byte_a = abs_a.GetByte(index);
-
-                if (index <= size_b)
-                    byte_b = abs_b.GetByte(index);
-
-                result.SetByte(index, byte_a ^ byte_b);
-            }
+        return result;
+    }
 
-            return result;
+    //  index of the highest set bit, size_t(-1) for zero
+    size_t highest_bit() const
+    {
+        for (size_t word = 0; word < _val.size(); ++word)
+        {
+            if (_val[word])
+                return (_val.size() - word) * 64 - 1 - count_leading_zeros(_val[word]);
         }
+
+        return size_t(-1);
     }
 
     friend std::ostream& operator<<(std::ostream&, string_distance const&);
 private:
+    static size_t count_leading_zeros(uint64_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return size_t(__builtin_clzll(value));
+#else
+        size_t count = 0;
+        for (uint64_t mask = uint64_t(1) << 63; 0 == (value & mask); mask >>= 1)
+            ++count;
+        return count;
+#endif
+    }
+
     value_type _val;
 };
 
-inline std::ostream& operator<<(std::ostream& o, string_distance const& r) 
-{ 
-    return o << r._val; 
+inline std::ostream& operator<<(std::ostream& o, string_distance const& r)
+{
+    std::ios_base::fmtflags flags(o.flags());
+    o << std::hex << std::setfill('0');
+    for (auto word : r._val)
+        o << std::setw(16) << word;
+    o.flags(flags);
+    return o;
+}
+
+//  used by contact_actions::index_from_distance
+inline size_t bucket_index(string_distance const& distance)
+{
+    return distance.highest_bit();
 }
 
 struct Konnection : details::Kontakt<std::string, string_distance>
@@ -116,8 +141,17 @@ struct Konnection : details::Kontakt<std::string, string_distance>
                peer_id const& peer = {})
         : details::Kontakt<node_id_type, distance_type>{ node_id }
         , _peer{ peer }
+        , _hashed_id{}
+        , _hashed{ false }
     {}
 
+    //  hides Kontakt::distance_from, uses the hash computed once.
+    //  it is computed on first use, lookups by nodeid never need it
+    distance_type distance_from(Konnection const& r) const
+    {
+        return hashed_id() - r.hashed_id();
+    }
+
     std::string to_string() const 
     { 
         std::ostringstream ss; 
@@ -136,5 +170,17 @@ struct Konnection : details::Kontakt<std::string, string_distance>
     }
 
 private:
+    distance_type const& hashed_id() const
+    {
+        if (false == _hashed)
+        {
+            _hashed_id = distance_type(get_id());
+            _hashed = true;
+        }
+        return _hashed_id;
+    }
+
     peer_id _peer;
+    mutable distance_type _hashed_id;
+    mutable bool _hashed;
 };
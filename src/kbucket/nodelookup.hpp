@@ -3,181 +3,124 @@
 #include "konnection.hpp"
 #include "kbucket.hpp"
 
-#include <atomic>
-
-struct NodeLookup
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+//  iterative kademlia lookup state, the caller does the messaging
+//  each response is fed to add_konnections() and next_probes() tells
+//  which up to alpha nodes, closest to the target and not asked yet,
+//  should be asked next. the lookup is complete when all of the k
+//  closest known nodes have been asked
+class NodeLookup
 {
-    NodeLookup(KBucket<Konnection> const & kbucket, Konnection const & node_to_search_) :
-        _kbucket_{kbucket},
-        kbucket {_kbucket_.rebase(node_to_search_, false)},
-        alpha_semaphore {alpha},
-        stall_counter {alpha},
-        _state{State::Running},
-        target {node_to_search_},
-        target_source {}
-    { }
-
-    std::vector<bool> add_konnections(Konnection const & source, const std::vector<Konnection > &konnections);
-    std::vector<Konnection> get_konnections();
+    using actions = contact_actions<Konnection>;
+    using distance_type = actions::distance_type;
 
-    bool update_peer(Konnection const & konnection);
+public:
+    NodeLookup(Konnection const& target_, size_t alpha_ = 3, size_t k_ = 20)
+        : target{ target_ }
+        , alpha{ alpha_ }
+        , k{ k_ }
+    {}
 
-    std::set<Konnection> candidate_list() const;
-    std::set<Konnection> orphan_list() const;
-    std::set<Konnection> drop_list() const;
+    //  returns true if any of the nodes got into the shortlist
+    bool add_konnections(std::vector<Konnection> const& konnections);
+    //  nodes already known to the caller, considered as asked
+    void add_probed(std::vector<Konnection> const& konnections);
 
+    std::vector<Konnection> next_probes();
+    std::vector<Konnection> closest() const;
 
-    typename KBucket<Konnection>::iterator begin() const { return kbucket.begin(); }
-    typename KBucket<Konnection>::iterator end() const { return kbucket.end(); }
-    bool is_complete() const { return _state != State::Running; }
+    bool is_complete() const;
 
 private:
-    enum {alpha = 3};
-
-    KBucket<Konnection> const & _kbucket_;
-    KBucket<Konnection> kbucket;
+    bool add(Konnection const& konnection);
 
-    std::atomic<int> alpha_semaphore, stall_counter;
+    Konnection target;
+    size_t alpha;
+    size_t k;
 
-    enum class State {Running, Stalled, Found} _state;
-
-    std::set<Konnection> probed_set, sources_set;
-    Konnection target, target_source;
+    std::map<distance_type, Konnection> shortlist;
+    std::set<std::string> probed_set;
 };
 
-
-std::vector<bool> NodeLookup::add_konnections(Konnection const & source, std::vector<Konnection> const & konnections)
+inline bool NodeLookup::add(Konnection const& konnection)
 {
-    std::vector<bool> result;
+    auto distance = actions::distance(target, konnection);
+    if (distance == actions::zero())
+        return false;
 
-    if (is_complete())
-        return result;
+    if (shortlist.size() >= k &&
+        false == (distance < shortlist.rbegin()->first))
+        return false;
 
-    if (probed_set.find(source) == std::end(probed_set))
-        return result;
+    if (false == shortlist.insert({distance, konnection}).second)
+        return false;
 
-    auto _front = kbucket.cbegin();
+    if (shortlist.size() > k)
+        shortlist.erase(std::prev(shortlist.end()));
 
-    bool new_source = false;
-    std::tie(std::ignore, new_source) = sources_set.insert(source);
-
-    if ( new_source )
-        ++alpha_semaphore;
+    return true;
+}
 
+inline bool NodeLookup::add_konnections(std::vector<Konnection> const& konnections)
+{
+    bool improved = false;
 
-    for (auto const & konnection : konnections)
+    for (auto const& konnection : konnections)
     {
-        if ( target == konnection )
-        {
-            _state = State::Found;
-            target_source = source;
-            return {};
-        }
-        if ( probed_set.find(konnection) == std::end(probed_set) )
-            result.push_back(kbucket.insert(konnection).second);
+        if (add(konnection))
+            improved = true;
     }
 
-    if ( new_source && _front == kbucket.cbegin() )
-        --stall_counter;
-    else if ( new_source )
-        stall_counter = alpha;
-
-
-    if ( 0 == stall_counter ||                           // alpha number of consecutive new sources have not improved the state
-         sources_set.size() > KBucket<Konnection>::LEVELS  // maximum number of sources have been considered
-         )
-        _state = State::Stalled;
-
-    return result;
+    return improved;
 }
 
-bool NodeLookup::update_peer(Konnection const & konnection)
+inline void NodeLookup::add_probed(std::vector<Konnection> const& konnections)
 {
-    auto const & it = kbucket.find(konnection);
-    return kbucket.replace(it, konnection);
-}
-
-std::set<Konnection> NodeLookup::candidate_list() const
-{
-    if ( State::Found == _state && target.get_peer().empty() )
-        return {target_source};
-    else
+    for (auto const& konnection : konnections)
     {
-        std::set<Konnection> result;
-        for (auto const & _list : kbucket.list_closests())
-            result.insert(_list);
-        return result;
+        probed_set.insert(konnection.to_string());
+        add(konnection);
     }
 }
 
-std::set<Konnection> NodeLookup::orphan_list() const
-{
-    auto const &_list = candidate_list();
-    decltype(candidate_list()) result;
-
-    for (auto const &li : _list)
-        if(li.get_peer().empty())
-            result.insert(li);
-
-    return result;
-}
-
-std::set<Konnection> NodeLookup::drop_list() const
+inline std::vector<Konnection> NodeLookup::next_probes()
 {
-    std::set<Konnection> result {};
+    std::vector<Konnection> result;
 
-    auto _begin = begin();
-    auto const & _end = end();
-    auto const & _list = candidate_list();
-    for ( ; _begin != _end; ++_begin )
+    for (auto const& item : shortlist)
     {
-        Konnection const & konnection = *_begin;
-
-        if ( is_complete() && _list.find(konnection) != _list.end() )
-            continue;
+        if (result.size() == alpha)
+            break;
 
-        if ( false == konnection.get_peer().empty() )
-            result.insert(konnection);
+        if (probed_set.insert(item.second.to_string()).second)
+            result.push_back(item.second);
     }
 
     return result;
 }
 
-std::vector<Konnection> NodeLookup::get_konnections()
+inline std::vector<Konnection> NodeLookup::closest() const
 {
     std::vector<Konnection> result;
 
-    if ( is_complete() )
-        return result;
-
-    if ( 0 == alpha_semaphore )
-        return result;
-
-    auto const & _list = candidate_list();
-    auto _begin = _list.begin();
-    auto _end = _list.end();
-    if (std::distance(_begin, _end) > alpha_semaphore)
-    {
-        _end = _begin;
-        std::advance(_end, alpha_semaphore.load());
-    }
-
-    std::copy_if(_begin, _end, std::back_inserter(result), [&](const Konnection &k) {
-        return ( probed_set.find(k) == probed_set.end() && ! k.get_peer().empty() );
-    });
+    for (auto const& item : shortlist)
+        result.push_back(item.second);
 
-    if (result.empty())
-        _state = State::Stalled;
+    return result;
+}
 
-    for (auto const &el : result)
+inline bool NodeLookup::is_complete() const
+{
+    for (auto const& item : shortlist)
     {
-        probed_set.insert(el);
-        --alpha_semaphore;
+        if (0 == probed_set.count(item.second.to_string()))
+            return false;
     }
 
-    return result;
+    return true;
 }
-
-
-
-
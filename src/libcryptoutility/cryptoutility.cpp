@@ -16,6 +16,7 @@
 #include <cryptopp/aes.h>
 #include <cryptopp/modes.h>
 
+#include <algorithm>
 #include <string>
 #include <cassert>
 #include <vector>
@@ -510,47 +511,66 @@ string ECIES_decrypt(string const& key, string const& cipher_b64_msg)
 
 uint64_t distance(string const& hash58_first, string const& hash58_second)
 {
-    vector<unsigned char> vec_first, vec_second;
-    vec_first = detail::from_base58(hash58_first.c_str());
-    vec_second = detail::from_base58(hash58_second.c_str());
-    if (vec_first.empty())
-        throw runtime_error("invalid base58 string: " + hash58_first);
-    if (vec_second.empty())
-        throw runtime_error("invalid base58 string: " + hash58_second);
+    return distance_raw(hash_digest_from_base58(hash58_first),
+                        hash_digest_from_base58(hash58_second));
+}
 
-    if (vec_first.size() != 32)
-        throw runtime_error("not a valid hash: " + hash58_first);
-    if (vec_second.size() != 32)
-        throw runtime_error("not a valid hash: " + hash58_second);
+hash_digest hash_digest_from_base58(string const& hash58)
+{
+    vector<unsigned char> vec = detail::from_base58(hash58.c_str());
+    if (vec.empty())
+        throw runtime_error("invalid base58 string: " + hash58);
 
-    auto setbitcount = [](unsigned char ch)
-    {
-        size_t res = 0;
-        unsigned char test = 1;
-        for (size_t index = 0; index < 8; ++index)
-        {
-            unsigned char temp = test & ch;
-            res += (0 != temp);
-            test *= 2;
-        }
+    if (vec.size() != 32)
+        throw runtime_error("not a valid hash: " + hash58);
 
-        return res;
-    };
+    hash_digest result;
+    std::copy(vec.begin(), vec.end(), result.begin());
+    return result;
+}
 
+uint64_t distance_raw(hash_digest const& first, hash_digest const& second)
+{
+    //  bit i of the result, counting from the most significant of 32,
+    //  is set if byte i of the xor has at least 6 - i / 8 bits set
+    //  eight bytes are handled at once, in a big endian word
     uint32_t compress_int = 0;
-    for (uint32_t index = 0; index < 32; ++index)
+    for (size_t word = 0; word < 4; ++word)
     {
-        unsigned char ch = vec_first[index] ^ vec_second[index];
-        uint32_t k = 6 - index / 8;
-        uint32_t temp = (k <= setbitcount(ch));
+        uint64_t value = 0;
+        for (size_t index = word * 8; index < word * 8 + 8; ++index)
+            value = (value << 8) | uint64_t(first[index] ^ second[index]);
+
+        //  set bit count of each byte, in that byte
+        value = value - ((value >> 1) & 0x5555555555555555ull);
+        value = (value & 0x3333333333333333ull) + ((value >> 2) & 0x3333333333333333ull);
+        value = (value + (value >> 4)) & 0x0f0f0f0f0f0f0f0full;
 
-        compress_int *= 2;
-        compress_int |= temp;
+        //  counts are at most 8, adding 128 - k does not carry over
+        //  to the next byte and sets its high bit if count >= k
+        uint64_t k = 6 - word;
+        value = (value + (0x80 - k) * 0x0101010101010101ull) & 0x8080808080808080ull;
+
+        //  gather the high bits of the eight bytes into one byte
+        uint32_t bits = uint32_t(((value >> 7) * 0x0102040810204080ull) >> 56);
+
+        compress_int = (compress_int << 8) | bits;
     }
 
     return compress_int;
 }
 
+vector<uint64_t> distance_raw(hash_digest const& first, vector<hash_digest> const& others)
+{
+    vector<uint64_t> result;
+    result.reserve(others.size());
+
+    for (auto const& other : others)
+        result.push_back(distance_raw(first, other));
+
+    return result;
+}
+
 
 //string base64_to_hex(const string & b64_str)
 //{
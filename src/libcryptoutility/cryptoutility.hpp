@@ -2,6 +2,8 @@
 
 #include "global.hpp"
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <exception>
@@ -176,4 +178,11 @@ CRYPTOUTILITYSHARED_EXPORT std::string ECIES_decrypt(std::string const& key, std
 
 CRYPTOUTILITYSHARED_EXPORT uint64_t distance(std::string const& hash58_first, std::string const& hash58_second);
 
+//  raw form of the hashes accepted by distance, decode once
+//  and use distance_raw for repeated comparisons
+using hash_digest = std::array<unsigned char, 32>;
+CRYPTOUTILITYSHARED_EXPORT hash_digest hash_digest_from_base58(std::string const& hash58);
+CRYPTOUTILITYSHARED_EXPORT uint64_t distance_raw(hash_digest const& first, hash_digest const& second);
+CRYPTOUTILITYSHARED_EXPORT std::vector<uint64_t> distance_raw(hash_digest const& first, std::vector<hash_digest> const& others);
+
 }
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace meshpp
+{
+namespace detail
+{
+//  outgoing connections in flight, keyed by the peer ids the socket gave
+//  for them and counted per address. an address that failed is not
+//  dialed again before its backoff is over
+class dial_tracker
+{
+public:
+    using peer_id = std::string;
+    using clock = std::chrono::steady_clock;
+
+    dial_tracker(size_t limit_,
+                 clock::duration timeout_,
+                 clock::duration backoff_base_,
+                 clock::duration backoff_max_,
+                 unsigned seed)
+        : limit(limit_)
+        , timeout(timeout_)
+        , backoff_base(backoff_base_)
+        , backoff_max(backoff_max_)
+        , random(seed)
+    {}
+
+    //  number of addresses being dialed
+    size_t dialing() const
+    {
+        return dialing_addresses.size();
+    }
+
+    bool at_limit() const
+    {
+        return dialing() >= limit;
+    }
+
+    bool allowed(std::string const& key, clock::time_point now) const
+    {
+        if (dialing_addresses.count(key))
+            return false;
+
+        auto it = backoffs.find(key);
+        return (it == backoffs.end() ||
+                it->second.not_before <= now);
+    }
+
+    //  the dial is followed by the peer ids sk.open() gave for it, the
+    //  socket reports back the outcome of each with the same peer id
+    template <typename T_peers>
+    void started(std::string const& key, T_peers const& peers, clock::time_point now)
+    {
+        for (auto const& peer : peers)
+        {
+            if (in_flight.count(peer))
+                continue;
+
+            attempt& item = in_flight[peer];
+            item.key = key;
+            item.started = now;
+            ++dialing_addresses[key];
+        }
+    }
+
+    //  the other attempts to the same address are not waited for
+    void succeeded(peer_id const& peer)
+    {
+        auto it_peer = in_flight.find(peer);
+        if (it_peer == in_flight.end())
+            return; //  accepted, not dialed
+
+        std::string key = it_peer->second.key;
+
+        auto it = in_flight.begin();
+        while (it != in_flight.end())
+        {
+            if (it->second.key == key)
+                it = in_flight.erase(it);
+            else
+                ++it;
+        }
+        dialing_addresses.erase(key);
+        backoffs.erase(key);
+    }
+
+    //  the address backs off once its last attempt in flight has failed
+    void failed(peer_id const& peer, clock::time_point now)
+    {
+        auto it_peer = in_flight.find(peer);
+        if (it_peer == in_flight.end())
+            return;
+
+        std::string key = it_peer->second.key;
+        in_flight.erase(it_peer);
+
+        auto it_address = dialing_addresses.find(key);
+        if (it_address != dialing_addresses.end() &&
+            0 != --it_address->second)
+            return;
+
+        dialing_addresses.erase(key);
+        back_off(key, now);
+    }
+
+    //  next attempt is not earlier than base * 2^(failures - 1), up to
+    //  the max, taken randomly from half to one and a half of that, so
+    //  that addresses failed together are not retried together
+    void back_off(std::string const& key, clock::time_point now)
+    {
+        auto& backoff = backoffs[key];
+        ++backoff.failures;
+
+        size_t shift = std::min(backoff.failures - 1, size_t(16));
+        double delay = std::min(std::chrono::duration<double>(backoff_base).count() * double(size_t(1) << shift),
+                                std::chrono::duration<double>(backoff_max).count());
+        std::uniform_real_distribution<double> jitter(0.5, 1.5);
+
+        backoff.not_before = now +
+                             std::chrono::duration_cast<clock::duration>(
+                                 std::chrono::duration<double>(delay * jitter(random)));
+    }
+
+    //  attempts not answered in time count as failed
+    void expire(clock::time_point now)
+    {
+        std::vector<peer_id> timed_out;
+        for (auto const& item : in_flight)
+        {
+            if (item.second.started + timeout <= now)
+                timed_out.push_back(item.first);
+        }
+        for (auto const& peer : timed_out)
+            failed(peer, now);
+
+        //  addresses that did not come back for long start from scratch
+        auto it = backoffs.begin();
+        while (it != backoffs.end())
+        {
+            if (it->second.not_before + backoff_max <= now)
+                it = backoffs.erase(it);
+            else
+                ++it;
+        }
+    }
+
+private:
+    class attempt
+    {
+    public:
+        std::string key;
+        clock::time_point started;
+    };
+
+    class backoff_state
+    {
+    public:
+        size_t failures = 0;
+        clock::time_point not_before;
+    };
+
+    size_t limit;
+    clock::duration timeout;
+    clock::duration backoff_base;
+    clock::duration backoff_max;
+    std::mt19937 random;
+
+    std::unordered_map<peer_id, attempt> in_flight;
+    //  number of attempts in flight to each address
+    std::unordered_map<std::string, size_t> dialing_addresses;
+    std::unordered_map<std::string, backoff_state> backoffs;
+};
+}
+}
@@ -3,15 +3,21 @@
 #include <kbucket/kbucket.hpp>
 #include "p2pstate.hpp"
 #include "message.hpp"
+#include "verification_queue.hpp"
+#include "dial_tracker.hpp"
 
 #include <belt.pp/packet.hpp>
 #include <belt.pp/utility.hpp>
 #include <belt.pp/scope_helper.hpp>
 #include <belt.pp/timer.hpp>
 
+#include <algorithm>
+#include <deque>
 #include <exception>
+#include <random>
 #include <stdexcept>
 #include <thread>
+#include <unordered_map>
 
 using namespace P2PMessage;
 
@@ -28,10 +34,23 @@ using std::string;
 using std::vector;
 using std::unique_ptr;
 using std::unordered_set;
+using std::unordered_map;
 
 using sf = beltpp::socket_family_t<&message_list_load>;
 
 #define PING_INTERVAL 30
+//  peers are dropped after 10 ticks without a ping, keep this well below
+#define PING_SPREAD_TICKS 3
+//  signature checks waiting for each worker thread, the ones over
+//  that are done in receive()
+#define VERIFICATIONS_PER_THREAD 16
+//  outgoing connections being opened at the same time
+#define DIAL_LIMIT 16
+//  seconds, a dial not answered in time counts as failed
+#define DIAL_TIMEOUT 30
+//  seconds, retry delay doubles with each failure up to the max
+#define DIAL_BACKOFF_BASE 1
+#define DIAL_BACKOFF_MAX 300
 
 namespace meshpp
 {
@@ -85,11 +104,22 @@ public:
                            beltpp::take_unique_ptr(std::move(inject_socket)) )
         , m_ptr_state(getp2pstate(sk.get_public_key()))
         , plogger(_plogger)
+        , logging_level(p2psocket::log_level::info)
         , connect_to_addresses(init_bind_to_address(discovery_server, bind_to_address, connect_to_addresses_))
         , receive_attempt_count(0)
+        , ping_tick(0)
+        , peh(&eh)
+        , send_queue_enabled(false)
+        , send_batch_size(0)
+        , dials(DIAL_LIMIT,
+                chrono::seconds(DIAL_TIMEOUT),
+                chrono::seconds(DIAL_BACKOFF_BASE),
+                chrono::seconds(DIAL_BACKOFF_MAX),
+                std::random_device()())
         , _secret_key(sk)
         , m_configured_connect_timer()
         , m_configured_reconnect_timer()
+        , m_status_summary_timer()
     {
         if (bind_to_address.local.empty() &&
             connect_to_addresses.empty())
@@ -109,26 +139,239 @@ public:
 
         m_configured_connect_timer.set(std::chrono::seconds(1));
         m_configured_reconnect_timer.set(std::chrono::minutes(5));
+        m_status_summary_timer.set(std::chrono::minutes(1));
     }
 
-    void writeln(string const& value)
+    bool log_enabled(p2psocket::log_level level) const
     {
-        if (plogger)
+        return plogger &&
+               level <= logging_level &&
+               plogger->enabled();
+    }
+
+    void writeln(p2psocket::log_level level, char const* value)
+    {
+        if (log_enabled(level))
+            plogger->message(value);
+    }
+
+    void writeln(p2psocket::log_level level, string const& value)
+    {
+        if (log_enabled(level))
             plogger->message(value);
     }
 
+    //  the message is built only if it is going to be written
+    template <typename T_message_builder>
+    void writeln(p2psocket::log_level level, T_message_builder const& build)
+    {
+        if (log_enabled(level))
+            plogger->message(build());
+    }
+
+    //  the signature is checked on a worker thread, the message and the
+    //  packets received from the same peer after it are parked till then
+    template <typename T_message>
+    bool verify_later(p2psocket::peer_id const& peer,
+                      bool ping,
+                      string const& nodeid,
+                      string const& message,
+                      string const& signature_b58,
+                      T_message& msg)
+    {
+        if (nullptr == verifications ||
+            verifications->full())
+            return false;
+
+        return verifications->verify_later(peer,
+                                           ping,
+                                           nodeid,
+                                           message,
+                                           signature_b58,
+                                           beltpp::packet(std::move(msg)));
+    }
+
+    bool is_parked(p2psocket::peer_id const& peer) const
+    {
+        return verifications && verifications->is_parked(peer);
+    }
+
+    void forget_parked(p2psocket::peer_id const& peer)
+    {
+        if (verifications)
+            verifications->forget(peer);
+    }
+
+    //  parked packets of the first peer whose check is done, in the order
+    //  they were received. the verified packet is left out if check failed
+    bool take_verified(p2pstate& state,
+                       p2psocket::peer_id& peer,
+                       p2psocket::packets& result)
+    {
+        if (nullptr == verifications)
+            return false;
+
+        verification_queue<beltpp::packet>::result checked;
+        std::deque<beltpp::packet> parked;
+        if (false == verifications->take(checked, parked))
+            return false;
+
+        if (checked.verified && checked.ping)
+            state.set_peer_verified(checked.peer, checked.nodeid);
+        else if (checked.verified)
+            verified_pongs[checked.peer] = checked.nodeid;
+        else
+        {
+            writeln(p2psocket::log_level::info, [&]{ return "signature verification failed: " + checked.peer; });
+            parked.pop_front();
+        }
+
+        peer = checked.peer;
+        result.clear();
+        for (auto& parked_packet : parked)
+            result.emplace_back(std::move(parked_packet));
+
+        return true;
+    }
+
+    void enqueue(p2psocket::peer_id const& p2p_peerid,
+                 beltpp::packet&& pack)
+    {
+        auto& queue = send_queues[p2p_peerid];
+        queue.push_back(std::move(pack));
+
+        //  without a send queue a full batch does not wait for prepare_wait
+        if (false == send_queue_enabled &&
+            queue.size() >= send_batch_size)
+            write_send_queue(p2p_peerid, queue, queue.size());
+    }
+
+    //  the first count packets of the queue, in OtherBatch messages if
+    //  batching is on and the peer advertised it can read them
+    void write_send_queue(p2psocket::peer_id const& p2p_peerid,
+                          std::deque<beltpp::packet>& queue,
+                          size_t count)
+    {
+        count = std::min(count, queue.size());
+
+        size_t batch_size = 0;
+        auto it_batching = batching_peers.find(p2p_peerid);
+        if (it_batching != batching_peers.end())
+            batch_size = std::min(send_batch_size, it_batching->second);
+
+        bool batching = (batch_size >= 2);
+
+        while (0 != count)
+        {
+            if (false == batching || 1 == count)
+            {
+                Other wrapper;
+                wrapper.contents = std::move(queue.front());
+                queue.pop_front();
+                --count;
+
+                m_ptr_socket->send(p2p_peerid, beltpp::packet(std::move(wrapper)));
+            }
+            else
+            {
+                OtherBatch batch;
+                size_t batch_count = std::min(count, batch_size);
+                batch.contents.reserve(batch_count);
+                for (size_t index = 0; index < batch_count; ++index)
+                {
+                    batch.contents.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+                count -= batch_count;
+
+                m_ptr_socket->send(p2p_peerid, beltpp::packet(std::move(batch)));
+            }
+        }
+    }
+
+    //  tells the peer it may send OtherBatch to this node
+    void send_batch_capable(p2psocket::peer_id const& p2p_peerid)
+    {
+        OtherBatchCapable msg;
+        msg.max_batch = send_batch_size;
+        m_ptr_socket->send(p2p_peerid, beltpp::packet(std::move(msg)));
+    }
+
+    //  all of the queued packets are handed to the socket, belt.pp does
+    //  not tell when a peer can take more, so nothing is held back
+    void flush_send_queues()
+    {
+        auto it = send_queues.begin();
+        while (it != send_queues.end())
+        {
+            auto& queue = it->second;
+
+            write_send_queue(it->first, queue, queue.size());
+
+            if (queue.empty())
+                it = send_queues.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    static string dial_key(ip_address const& addr)
+    {
+        return addr.remote.address + ":" + std::to_string(addr.remote.port);
+    }
+
+    bool dial_allowed(ip_address const& addr) const
+    {
+        return dials.allowed(dial_key(addr), steady_clock::now());
+    }
+
+    template <typename T_peers>
+    void dial_started(ip_address const& addr, T_peers const& peers)
+    {
+        dials.started(dial_key(addr), peers, steady_clock::now());
+    }
+
+    void dial_succeeded(p2psocket::peer_id const& peer)
+    {
+        dials.succeeded(peer);
+    }
+
+    void dial_failed(p2psocket::peer_id const& peer)
+    {
+        dials.failed(peer, steady_clock::now());
+    }
+
+    void backoff_dial(ip_address const& addr)
+    {
+        dials.back_off(dial_key(addr), steady_clock::now());
+    }
+
     bool discovery_server;
     t_unique_ptr<socket> m_ptr_socket;
     meshpp::p2pstate_ptr m_ptr_state;
 
     beltpp::ilog* plogger;
+    p2psocket::log_level logging_level;
     std::vector<ip_address> const connect_to_addresses;
     ip_address the_first_connect_to_address_from_socket;
     size_t receive_attempt_count;
+    size_t ping_tick;
+    beltpp::event_handler* peh;
+    unique_ptr<verification_queue<beltpp::packet>> verifications;
+    //  pongs checked by take_verified(), they do not verify the session
+    unordered_map<p2psocket::peer_id, string> verified_pongs;
+    bool send_queue_enabled;
+    size_t send_batch_size;
+    unordered_map<p2psocket::peer_id, std::deque<beltpp::packet>> send_queues;
+    //  max_batch each peer sent in OtherBatchCapable
+    unordered_map<p2psocket::peer_id, size_t> batching_peers;
+    dial_tracker dials;
     meshpp::private_key _secret_key;
     beltpp::timer m_configured_connect_timer;
     beltpp::timer m_configured_reconnect_timer;
+    beltpp::timer m_status_summary_timer;
     unordered_set<p2psocket::peer_id> notify_removed_peers;
+    unordered_set<p2psocket::peer_id> notify_joined_peers;
 };
 }
 
@@ -196,27 +439,62 @@ static void remove_if_configured_address(std::unique_ptr<detail::p2psocket_inter
 {
     if (is_configured_address(pimpl, item))
     {
-        pimpl->writeln("remove_later item, 0, false: " + item.to_string());
+        pimpl->writeln(p2psocket::log_level::info, [&]{ return "remove_later item, 0, false: " + item.to_string(); });
         pimpl->m_ptr_state->remove_later(item, 0, false, true, false);
     }
 }
 
+//  the pong or its absence decides if a replacement takes the place
+//  of the least recently seen contact
+static void send_eviction_probes(std::unique_ptr<detail::p2psocket_internals> const& pimpl)
+{
+    p2pstate& state = *pimpl->m_ptr_state.get();
+    socket& sk = *pimpl->m_ptr_socket.get();
+
+    for (auto const& probe_peer : state.take_eviction_probes())
+    {
+        Ping ping_msg;
+        try
+        {
+            beltpp::assign(ping_msg.connection_info, sk.info(probe_peer));
+        }
+        catch (...)
+        {
+            continue;   //  gone already, the timeout will evict it
+        }
+        ping_msg.nodeid = state.name();
+        ping_msg.stamp.tm = system_clock::to_time_t(system_clock::now());
+
+        pimpl->writeln(p2psocket::log_level::trace, [&]{ return "pinging least recently seen contact " + probe_peer; });
+        sk.send(probe_peer, beltpp::packet(std::move(ping_msg)));
+    }
+}
+
 void p2psocket::prepare_wait()
 {
     p2pstate& state = *m_pimpl->m_ptr_state.get();
     socket& sk = *m_pimpl->m_ptr_socket.get();
 
+    //  before the drops below, so that queued packets get there first
+    m_pimpl->flush_send_queues();
+
     auto to_remove = state.remove_pending();
     for (auto const& to_remove_item : to_remove.first)
     {
         if (to_remove_item.second)
             m_pimpl->notify_removed_peers.insert(to_remove_item.first);
     }
+    for (auto const& promoted_nodeid : state.take_promoted_contacts())
+        m_pimpl->notify_joined_peers.insert(promoted_nodeid);
     for (auto const& remove_sk : to_remove.second)
     {
-        m_pimpl->writeln("sending drop");
+        m_pimpl->writeln(p2psocket::log_level::info, "sending drop");
 
         state.set_peer_unverified(remove_sk);
+        m_pimpl->forget_parked(remove_sk);
+        m_pimpl->verified_pongs.erase(remove_sk);
+        m_pimpl->send_queues.erase(remove_sk);
+        m_pimpl->batching_peers.erase(remove_sk);
 
         sk.send(remove_sk, beltpp::packet(beltpp::stream_drop()));
     }
@@ -230,7 +508,7 @@ void p2psocket::prepare_wait()
 
         item.local.port = state.get_fixed_local_port();
 
-        m_pimpl->writeln("start to listen on " + item.to_string());
+        m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "start to listen on " + item.to_string(); });
 
         beltpp::on_failure guard_failure([&state, &item]
         {
@@ -242,7 +520,7 @@ void p2psocket::prepare_wait()
         for (auto const& peer_item : peers)
         {
             auto conn_item = sk.info(peer_item);
-            m_pimpl->writeln("listening on " + conn_item.to_string());
+            m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "listening on " + conn_item.to_string(); });
 
             state.add_active(conn_item, peer_item);
         }
@@ -259,7 +537,7 @@ void p2psocket::prepare_wait()
         m_pimpl->m_configured_connect_timer.update();
         for (auto const& item : m_pimpl->connect_to_addresses)
         {
-            m_pimpl->writeln("add_passive item: " + item.to_string());
+            m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "add_passive item: " + item.to_string(); });
             state.add_passive(item);
         }
     }
@@ -268,43 +546,65 @@ void p2psocket::prepare_wait()
         m_pimpl->m_configured_reconnect_timer.update();
         for (auto const& item : m_pimpl->connect_to_addresses)
         {
-            m_pimpl->writeln("add_passive item: " + item.to_string());
+            m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "add_passive item: " + item.to_string(); });
             state.add_passive(item);
         }
     }
 
+    m_pimpl->dials.expire(steady_clock::now());
+
+    //  without contacts the configured addresses are the way in, otherwise
+    //  the addresses learned from peers go first to fill the kbucket
+    bool configured_first = state.contacts_empty();
+    std::stable_partition(to_connect.begin(), to_connect.end(),
+                          [this, configured_first](ip_address const& item)
+    {
+        return configured_first == is_configured_address(m_pimpl, item);
+    });
+
     for (auto const& item : to_connect)
     {
+        //  the ones not dialed now stay in the todo list for later
+        if (m_pimpl->dials.at_limit())
+            break;
+        if (false == m_pimpl->dial_allowed(item))
+            continue;
+
         beltpp::finally guard_finally([&state, &item]
         {
             state.remove_from_todo_list(item);
         });
         beltpp::on_failure guard_failure([this, &item]
         {
+            m_pimpl->backoff_dial(item);
             remove_if_configured_address(m_pimpl, item);
         });
 
         size_t attempts = state.get_open_attempts(item);
 
-        m_pimpl->writeln("connect to " + item.to_string());
+        m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "connect to " + item.to_string(); });
         auto open_res = sk.open(item, attempts);
         for (auto const& open_res_item : open_res)
         {
-            m_pimpl->writeln("peerid " + open_res_item);
+            m_pimpl->writeln(p2psocket::log_level::trace, [&]{ return "peerid " + open_res_item; });
         }
 
         state.remove_later(item, 30, false, true, false);
+        m_pimpl->dial_started(item, open_res);
 
         guard_failure.dismiss();
     }   //  for to_connect
 
     if (0 == m_pimpl->receive_attempt_count)
-        m_pimpl->writeln(state.short_name() + " reading...");
+        m_pimpl->writeln(p2psocket::log_level::trace, [&]{ return state.short_name() + " reading..."; });
     else
-        m_pimpl->writeln("    " +
-                         state.short_name() +
-                         " still reading... " +
-                         std::to_string(m_pimpl->receive_attempt_count));
+        m_pimpl->writeln(p2psocket::log_level::trace, [&]
+        {
+            return "    " +
+                   state.short_name() +
+                   " still reading... " +
+                   std::to_string(m_pimpl->receive_attempt_count);
+        });
 
     sk.prepare_wait();
 }
@@ -329,18 +629,39 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
         return return_packets;
     }
 
-    packets received_packets = sk.receive(current_peer);
+    if (false == m_pimpl->notify_joined_peers.empty())
+    {
+        auto it_begin = m_pimpl->notify_joined_peers.begin();
+        peer = *it_begin;
+        m_pimpl->notify_joined_peers.erase(it_begin);
+
+        return_packets.emplace_back(beltpp::stream_join());
+        return return_packets;
+    }
+
+    packets received_packets;
+    //  packets that were waiting for a signature check go first
+    if (false == m_pimpl->take_verified(state, current_peer, received_packets))
+        received_packets = sk.receive(current_peer);
 
     if (false == received_packets.empty())
     {
         m_pimpl->receive_attempt_count = 0;
-        m_pimpl->writeln("done");
+        m_pimpl->writeln(p2psocket::log_level::trace, "done");
     }
     else
         ++m_pimpl->receive_attempt_count;
 
     for (auto& received_packet : received_packets)
     {
+        //  keep the order of packets from a peer with a pending check
+        if (beltpp::stream_drop::rtt != received_packet.type() &&
+            m_pimpl->is_parked(current_peer))
+        {
+            m_pimpl->verifications->park(current_peer, std::move(received_packet));
+            continue;
+        }
+
         if (beltpp::stream_drop::rtt != received_packet.type() &&
             beltpp::socket_open_error::rtt != received_packet.type() &&
             beltpp::socket_open_refused::rtt != received_packet.type())
@@ -353,7 +674,7 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
 
         auto current_peer_nodeid = state.get_nodeid(current_peer);
 
-        m_pimpl->writeln("received current_connection, current_peer: " + current_connection.to_string() + ", " + current_peer);
+        m_pimpl->writeln(p2psocket::log_level::trace, [&]{ return "received current_connection, current_peer: " + current_connection.to_string() + ", " + current_peer; });
 
         /*beltpp::finally guard([this](){m_pimpl->plogger->disable();});
         if (current_peer_nodeid == "TPBQ7vkv2YrHBYkKd6JmRErxzoXLY7de1ohpTVd3XvMCejRRTwDvzk")
@@ -363,10 +684,12 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
         {
         case beltpp::stream_join::rtt:
         {
+            m_pimpl->dial_succeeded(current_peer);
+
             if (0 == state.get_fixed_local_port() ||
                 current_connection.local.port == state.get_fixed_local_port())
             {
-                m_pimpl->writeln("add_active current_connection, current_peer: " + current_connection.to_string() + ", " + current_peer);
+                m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "add_active current_connection, current_peer: " + current_connection.to_string() + ", " + current_peer; });
                 state.add_active(current_connection, current_peer);
 
                 Ping ping_msg;
@@ -378,18 +701,21 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
                 auto signed_message = m_pimpl->_secret_key.sign(message);
                 ping_msg.signature = signed_message.base58;
 
-                m_pimpl->writeln("sending ping with signed message");
-                m_pimpl->writeln(ping_msg.to_string());
+                m_pimpl->writeln(p2psocket::log_level::trace, "sending ping with signed message");
+                m_pimpl->writeln(p2psocket::log_level::trace, [&]{ return ping_msg.to_string(); });
                 sk.send(current_peer, beltpp::packet(ping_msg));
 
-                m_pimpl->writeln("remove_later current_peer, 10, true, false: " + current_peer + ", " + current_connection.to_string());
+                if (m_pimpl->send_batch_size >= 2)
+                    m_pimpl->send_batch_capable(current_peer);
+
+                m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "remove_later current_peer, 10, true, false: " + current_peer + ", " + current_connection.to_string(); });
                 state.remove_later(current_peer, 10, true, false);
 
                 state.set_fixed_local_port(current_connection.local.port);
 
                 ip_address to_listen(current_connection.local,
                                      current_connection.ip_type);
-                m_pimpl->writeln("add_passive to_listen: " + to_listen.to_string());
+                m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "add_passive to_listen: " + to_listen.to_string(); });
                 state.add_passive(to_listen);
             }
             else
@@ -401,11 +727,11 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
 
                 if (state.remove_later(current_connection, 0, false, true, false))
                 {
-                    m_pimpl->writeln("remove_later current_connection, 0, false: " + current_connection.to_string() + ", " + current_peer);
+                    m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "remove_later current_connection, 0, false: " + current_connection.to_string() + ", " + current_peer; });
 
                     current_connection.local.port = state.get_fixed_local_port();
 
-                    m_pimpl->writeln("add_passive current_connection: " + current_connection.to_string());
+                    m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "add_passive current_connection: " + current_connection.to_string(); });
                     state.add_passive(current_connection);
                 }
                 */
@@ -418,12 +744,15 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
             beltpp::stream_protocol_error msg;
             std::move(received_packet).get(msg);
 
-            m_pimpl->writeln("got error from bad guy " + current_connection.to_string());
-            m_pimpl->writeln(msg.buffer);
-            m_pimpl->writeln("dropping " + current_peer);
-            m_pimpl->writeln("remove_later current_peer, 0, true: " +
-                             current_peer + ", " +
-                             current_connection.to_string());
+            m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "got error from bad guy " + current_connection.to_string(); });
+            m_pimpl->writeln(p2psocket::log_level::info, msg.buffer);
+            m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "dropping " + current_peer; });
+            m_pimpl->writeln(p2psocket::log_level::info, [&]
+            {
+                return "remove_later current_peer, 0, true: " +
+                       current_peer + ", " +
+                       current_connection.to_string();
+            });
 
             state.remove_later(current_peer, 0, true, false);
 
@@ -442,6 +771,7 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
             auto msg_address = msg.address;
             return_packets.emplace_back(std::move(msg));
 
+            m_pimpl->dial_failed(current_peer);
             remove_if_configured_address(m_pimpl, msg_address);
             break;
         }
@@ -454,18 +784,26 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
             auto msg_address = msg.address;
             return_packets.emplace_back(std::move(msg));
 
+            m_pimpl->dial_failed(current_peer);
             remove_if_configured_address(m_pimpl, msg_address);
             break;
         }
         case beltpp::stream_drop::rtt:
         {
-            m_pimpl->writeln("dropped " + current_peer);
-            m_pimpl->writeln("remove_later current_peer, 0, true: " +
-                             current_peer + ", " +
-                             current_connection.to_string());
+            m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "dropped " + current_peer; });
+            m_pimpl->writeln(p2psocket::log_level::info, [&]
+            {
+                return "remove_later current_peer, 0, true: " +
+                       current_peer + ", " +
+                       current_connection.to_string();
+            });
 
             state.set_peer_unverified(current_peer);
             state.remove_later(current_peer, 0, false, false);
+            m_pimpl->forget_parked(current_peer);
+            m_pimpl->verified_pongs.erase(current_peer);
+            m_pimpl->send_queues.erase(current_peer);
+            m_pimpl->batching_peers.erase(current_peer);
 
             peer = current_peer_nodeid;
             if (false == current_peer_nodeid.empty())
@@ -479,7 +817,7 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
         }
         case Ping::rtt:
         {
-            m_pimpl->writeln("ping received from " + current_peer + " (" + current_peer_nodeid + ")");
+            m_pimpl->writeln(p2psocket::log_level::trace, [&]{ return "ping received from " + current_peer + " (" + current_peer_nodeid + ")"; });
             Ping msg;
             std::move(received_packet).get(msg);
 
@@ -509,28 +847,38 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
                     m_pimpl->plogger->enable();
                 }
 
-                m_pimpl->writeln("invalid ping timestamp from: " +
-                                 current_connection.to_string() + ", " +
-                                 msg.nodeid);
+                m_pimpl->writeln(p2psocket::log_level::info, [&]
+                {
+                    return "invalid ping timestamp from: " +
+                           current_connection.to_string() + ", " +
+                           msg.nodeid;
+                });
                 break;
             }
 
-            m_pimpl->writeln("verifying message");
-            m_pimpl->writeln(message);
+            m_pimpl->writeln(p2psocket::log_level::trace, "verifying message");
+            m_pimpl->writeln(p2psocket::log_level::trace, message);
 
             if (false == msg.signature.empty())
             {
-                if (!verify_signature(msg.nodeid, message, msg.signature))
+                //  a session verified for this nodeid recently is trusted
+                if (false == state.is_peer_verified(current_peer, msg.nodeid))
                 {
-                    m_pimpl->writeln("ping signature verification failed");
-                    break;
-                }
+                    if (m_pimpl->verify_later(current_peer, true, msg.nodeid, message, msg.signature, msg))
+                        break;
+
+                    if (!verify_signature(msg.nodeid, message, msg.signature))
+                    {
+                        m_pimpl->writeln(p2psocket::log_level::info, "ping signature verification failed");
+                        break;
+                    }
 
-                state.set_peer_verified(current_peer);
+                    state.set_peer_verified(current_peer, msg.nodeid);
+                }
             }
             else if (false == state.is_peer_verified(current_peer))
             {
-                m_pimpl->writeln("receive simple ping from unverified peer");
+                m_pimpl->writeln(p2psocket::log_level::info, "receive simple ping from unverified peer");
                 break;
             }
 
@@ -544,13 +892,13 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
                 }
 
                 if (empty_external_address_stored)
-                    m_pimpl->writeln("auto-detected public address is: " + external_address_ping.to_string());
+                    m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "auto-detected public address is: " + external_address_ping.to_string(); });
                 else if (external_address_stored != external_address_ping)
                 {
-                    m_pimpl->writeln("peer working on different route: " + current_connection.to_string());
-                    m_pimpl->writeln("will reset stored public address");
-                    m_pimpl->writeln("stored public address is: " + external_address_stored.to_string());
-                    m_pimpl->writeln("received ping public address is: " + external_address_ping.to_string());
+                    m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "peer working on different route: " + current_connection.to_string(); });
+                    m_pimpl->writeln(p2psocket::log_level::info, "will reset stored public address");
+                    m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "stored public address is: " + external_address_stored.to_string(); });
+                    m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "received ping public address is: " + external_address_ping.to_string(); });
                 }
 
                 external_address_stored = external_address_ping;
@@ -566,13 +914,14 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
                     guard = beltpp::finally([this]{m_pimpl->plogger->disable();});
                     m_pimpl->plogger->enable();
                 }
-                m_pimpl->writeln("peer working on different route: " + current_connection.to_string());
-                m_pimpl->writeln("stored public address is: " + external_address_stored.to_string());
-                m_pimpl->writeln("received ping public address is: " + external_address_ping.to_string());
+                m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "peer working on different route: " + current_connection.to_string(); });
+                m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "stored public address is: " + external_address_stored.to_string(); });
+                m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "received ping public address is: " + external_address_ping.to_string(); });
                 break;
             }
 
             p2pstate::contact_status status = state.add_contact(current_peer, msg.nodeid);
+            send_eviction_probes(m_pimpl);
 
             Pong msg_pong;
             msg_pong.nodeid = state.name();
@@ -580,7 +929,7 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
 
             string message_pong = msg_pong.nodeid + ::beltpp::gm_time_t_to_gm_string(msg_pong.stamp.tm);
             
-            m_pimpl->writeln(message_pong);
+            m_pimpl->writeln(p2psocket::log_level::trace, message_pong);
             
             if (false == msg.signature.empty())
             {
@@ -592,10 +941,12 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
 
             if (status != p2pstate::contact_status::no_contact)
             {
-                state.remove_later(current_peer, 10, true, true);
+                //  replacements are not announced, so neither is their drop
+                state.remove_later(current_peer, 10, true,
+                                   status != p2pstate::contact_status::replacement_contact);
                 state.set_active_nodeid(current_peer, msg.nodeid);
 
-                m_pimpl->writeln("remove_later current_peer, 10, true, true: " + current_peer + ", " + current_connection.to_string());
+                m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "remove_later current_peer, 10, true, true: " + current_peer + ", " + current_connection.to_string(); });
 
                 if (false == msg.nodeid.empty() && p2pstate::contact_status::new_contact == status)
                 {
@@ -610,10 +961,19 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
         }
         case Pong::rtt:
         {
-            m_pimpl->writeln("pong received from " + current_peer + " (" + current_peer_nodeid + ")");
+            m_pimpl->writeln(p2psocket::log_level::trace, [&]{ return "pong received from " + current_peer + " (" + current_peer_nodeid + ")"; });
             Pong msg;
             std::move(received_packet).get(msg);
 
+            //  the pong is given back by take_verified() after its check
+            bool verified_async = false;
+            auto it_verified = m_pimpl->verified_pongs.find(current_peer);
+            if (it_verified != m_pimpl->verified_pongs.end())
+            {
+                verified_async = (it_verified->second == msg.nodeid);
+                m_pimpl->verified_pongs.erase(it_verified);
+            }
+
             if (state.name() == msg.nodeid)
                 break;
 
@@ -621,27 +981,39 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
             string message = msg.nodeid + ::beltpp::gm_time_t_to_gm_string(msg.stamp.tm);
             if (chrono::seconds(-PING_INTERVAL) > diff || chrono::seconds(PING_INTERVAL) <= diff)
             {
-                m_pimpl->writeln("invalid pong timestamp");
+                m_pimpl->writeln(p2psocket::log_level::info, "invalid pong timestamp");
                 break;
             }
 
-            m_pimpl->writeln(message);
+            m_pimpl->writeln(p2psocket::log_level::trace, message);
 
             if (false == msg.signature.empty())
             {
-                if (!verify_signature(msg.nodeid, message, msg.signature))
+                //  a session verified by ping for this nodeid recently is
+                //  trusted. a pong does not mark the session as verified,
+                //  so it does not let simple pings and pongs through
+                if (false == verified_async &&
+                    false == state.is_peer_verified(current_peer, msg.nodeid))
                 {
-                    m_pimpl->writeln("pong signature verification failed");
-                    break;
+                    if (m_pimpl->verify_later(current_peer, false, msg.nodeid, message, msg.signature, msg))
+                        break;
+
+                    if (!verify_signature(msg.nodeid, message, msg.signature))
+                    {
+                        m_pimpl->writeln(p2psocket::log_level::info, "pong signature verification failed");
+                        break;
+                    }
                 }
             }
             else if (false == state.is_peer_verified(current_peer))
             {
-                m_pimpl->writeln("receive simple pong from unverified peer");
+                m_pimpl->writeln(p2psocket::log_level::info, "receive simple pong from unverified peer");
                 break;
             }
 
-            m_pimpl->writeln("sending find node");
+            state.contact_seen(current_peer_nodeid);
+
+            m_pimpl->writeln(p2psocket::log_level::trace, "sending find node");
 
             FindNode msg_fn;
             msg_fn.nodeid = state.name();
@@ -650,21 +1022,20 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
         }
         case FindNode::rtt:
         {
-            m_pimpl->writeln("find node received");
+            m_pimpl->writeln(p2psocket::log_level::trace, "find node received");
             FindNode msg;
             std::move(received_packet).get(msg);
 
             NodeDetails response;
             response.origin = state.name();
-            //response.nodeids = state.list_nearest_to(msg.nodeid);
-            response.nodeids = state.get_kbucket_nodeids();
+            response.nodeids = state.list_nearest_to(msg.nodeid);
 
             sk.send(current_peer, beltpp::packet(std::move(response)));
             break;
         }
         case NodeDetails::rtt:
         {
-            m_pimpl->writeln("node details received");
+            m_pimpl->writeln(p2psocket::log_level::trace, "node details received");
             NodeDetails msg;
             std::move(received_packet).get(msg);
 
@@ -682,7 +1053,7 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
         }
         case IntroduceTo::rtt:
         {
-            m_pimpl->writeln("introduce request received");
+            m_pimpl->writeln(p2psocket::log_level::trace, "introduce request received");
             IntroduceTo msg;
             std::move(received_packet).get(msg);
 
@@ -692,7 +1063,7 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
                 ip_address introduce_addr = sk.info(introduce_peer_id);
                 OpenConnectionWith msg_open;
 
-                m_pimpl->writeln("sending connect info " + introduce_addr.to_string());
+                m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "sending connect info " + introduce_addr.to_string(); });
 
                 assign(msg_open.addr, std::move(introduce_addr));
                 sk.send(current_peer, beltpp::packet(std::move(msg_open)));
@@ -704,7 +1075,7 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
         }
         case OpenConnectionWith::rtt:
         {
-            m_pimpl->writeln("connect info received");
+            m_pimpl->writeln(p2psocket::log_level::trace, "connect info received");
 
             OpenConnectionWith msg;
             std::move(received_packet).get(msg);
@@ -715,7 +1086,7 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
 
             if (false == m_pimpl->discovery_server)
             {
-                m_pimpl->writeln("add_passive connect_to, 1000: " + connect_to.to_string());
+                m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "add_passive connect_to, 1000: " + connect_to.to_string(); });
                 state.add_passive(connect_to, 1000);
             }
 
@@ -723,7 +1094,7 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
         }
         case Other::rtt:
         {
-            m_pimpl->writeln("sending extension data");
+            m_pimpl->writeln(p2psocket::log_level::trace, "sending extension data");
 
             peer = current_peer_nodeid;
             if (false == current_peer_nodeid.empty())
@@ -736,80 +1107,32 @@ p2psocket::packets p2psocket::receive(p2psocket::peer_id& peer)
             }
             break;
         }
-        }
-    }
-
-    // add missing two node lookup blocks
-    /* node lookup design is wrong, does not fit in
-    if(not option_query.empty()) // command to find some node)
-    {
-        Konnection<> konnection {option_query};
-
-        if(node_lookup)
+        case OtherBatch::rtt:
         {
-            // cleanup peers
-            for (auto const & _konnection : node_lookup->drop_list())
-            {
-                message_drop msg;
-                sk.send(_konnection.get_peer(), msg);
-            }
-        }
-        node_lookup.reset(new NodeLookup {kbucket, konnection});
-        option_query.clear();
-    }
+            m_pimpl->writeln(p2psocket::log_level::trace, "sending batched extension data");
 
-    if (node_lookup)
-    {
-        if ( not node_lookup->is_complete() )
-        {
-            for (auto const & _konnection : node_lookup->get_konnections())
+            peer = current_peer_nodeid;
+            if (false == current_peer_nodeid.empty())
             {
-                message_find_node msg;
-                msg.nodeid = static_cast<std::string>(_konnection);
-                sk.send(_konnection.get_peer(), msg);
+                OtherBatch pack;
+                std::move(received_packet).get(pack);
+                for (auto& contents_item : pack.contents)
+                    return_packets.emplace_back(std::move(contents_item));
+
+                state.process_node_join(current_peer_nodeid);
             }
+            break;
         }
-        else
+        case OtherBatchCapable::rtt:
         {
-            std::cout << "final candidate list";
-            for (auto const & _konnection : node_lookup->candidate_list())
-            {
-                message_ping msg;
-                msg.nodeid = static_cast<std::string>(_konnection);
-                sk.send(_konnection.get_peer(), msg);
-            }
-
-            for (auto const & _konnection : node_lookup->drop_list())
-            {
-                message_drop msg;
-                sk.send(_konnection.get_peer(), msg);
-            }
+            OtherBatchCapable msg;
+            std::move(received_packet).get(msg);
 
-            node_lookup.reset(nullptr);
+            m_pimpl->writeln(p2psocket::log_level::trace, [&]{ return "peer reads batches: " + current_peer; });
+            m_pimpl->batching_peers[current_peer] = msg.max_batch;
+            break;
+        }
         }
-    }*/
-
-    if (false == received_packets.empty())
-    {
-        std::time_t time_t_now = system_clock::to_time_t(system_clock::now());
-        m_pimpl->writeln(beltpp::gm_time_t_to_lc_string(time_t_now));
-
-        auto connected = state.get_connected_addresses();
-        auto listening = state.get_listening_addresses();
-
-        if (false == connected.empty())
-            m_pimpl->writeln("status summary - connected");
-        for (auto const& item : connected)
-            m_pimpl->writeln("    " + item.to_string());
-        if (false == listening.empty())
-            m_pimpl->writeln("status summary - listening");
-        for (auto const& item : listening)
-            m_pimpl->writeln("    " + item.to_string());
-
-        m_pimpl->writeln("KBucket list");
-        m_pimpl->writeln("--------");
-        m_pimpl->writeln(state.bucket_dump());
-        m_pimpl->writeln("========");
     }
 
     return return_packets;
@@ -825,9 +1148,12 @@ void p2psocket::send(peer_id const& peer,
     {
         if (pack.type() == beltpp::stream_drop::rtt)
         {
-            m_pimpl->writeln("remove_later p2p_peerid, 0, true: " + p2p_peerid);
+            m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "remove_later p2p_peerid, 0, true: " + p2p_peerid; });
             state.remove_later(p2p_peerid, 0, true, false);
         }
+        else if (m_pimpl->send_queue_enabled ||
+                 0 != m_pimpl->send_batch_size)
+            m_pimpl->enqueue(p2p_peerid, std::move(pack));
         else
         {
             Other wrapper;
@@ -839,6 +1165,62 @@ void p2psocket::send(peer_id const& peer,
         throw std::runtime_error("send() no such node: " + peer);
 }
 
+size_t p2psocket::broadcast(vector<peer_id> const& peers,
+                            packet&& pack)
+{
+    p2pstate& state = *m_pimpl->m_ptr_state.get();
+
+    vector<peer_id> destinations;
+    destinations.reserve(peers.size());
+    for (auto const& peer : peers)
+    {
+        peer_id p2p_peerid;
+        if (state.get_peer_id(peer, p2p_peerid))
+            destinations.push_back(p2p_peerid);
+    }
+
+    if (destinations.empty())
+        return 0;
+
+    if (pack.type() == beltpp::stream_drop::rtt)
+    {
+        for (auto const& destination : destinations)
+        {
+            m_pimpl->writeln(p2psocket::log_level::info, [&]{ return "remove_later p2p_peerid, 0, true: " + destination; });
+            state.remove_later(destination, 0, true, false);
+        }
+
+        return destinations.size();
+    }
+
+    //  the envelope is built once and copied for all but the last peer,
+    //  queued packets are wrapped when written so only contents are copied
+    Other wrapper;
+    wrapper.contents = std::move(pack);
+
+    bool queued = (m_pimpl->send_queue_enabled ||
+                   0 != m_pimpl->send_batch_size);
+
+    for (size_t index = 0; index < destinations.size(); ++index)
+    {
+        auto const& destination = destinations[index];
+        bool last = (index + 1 == destinations.size());
+
+        if (queued && last)
+            m_pimpl->enqueue(destination,
+                             std::move(wrapper.contents));
+        else if (queued)
+            m_pimpl->enqueue(destination,
+                             beltpp::packet(wrapper.contents));
+        else if (last)
+            m_pimpl->m_ptr_socket->send(destination, beltpp::packet(std::move(wrapper)));
+        else
+            m_pimpl->m_ptr_socket->send(destination, beltpp::packet(wrapper));
+    }
+
+    return destinations.size();
+}
+
 void p2psocket::timer_action()
 {
     p2pstate& state = *m_pimpl->m_ptr_state.get();
@@ -848,24 +1230,130 @@ void p2psocket::timer_action()
 
     state.do_step();
 
+    if (m_pimpl->m_status_summary_timer.expired())
+    {
+        m_pimpl->m_status_summary_timer.update();
+        m_pimpl->writeln(p2psocket::log_level::info, [this]{ return status_summary(); });
+    }
+
+    //  each peer is pinged on one of PING_SPREAD_TICKS ticks only,
+    //  so that a large peer set is not served in a single burst
+    size_t ping_slot = m_pimpl->ping_tick % PING_SPREAD_TICKS;
+    ++m_pimpl->ping_tick;
+
+    Ping ping_template;
+    ping_template.nodeid = state.name();
+    ping_template.stamp.tm = system_clock::to_time_t(system_clock::now());
+
     auto connected = state.get_connected_peerids();
     for (auto const& item : connected)
     {
-        Ping ping_msg;
+        if (std::hash<peer_id>()(item) % PING_SPREAD_TICKS != ping_slot)
+            continue;
+
+        Ping ping_msg = ping_template;
 
         ip_address current_connection = sk.info(item);
         beltpp::assign(ping_msg.connection_info, current_connection);
-        ping_msg.nodeid = state.name();
-        ping_msg.stamp.tm = system_clock::to_time_t(system_clock::now());
-        string message = ping_msg.nodeid + ::beltpp::gm_time_t_to_gm_string(ping_msg.stamp.tm);
 
-        m_pimpl->writeln("sending ping with signed message");
-        m_pimpl->writeln(ping_msg.to_string());
+        m_pimpl->writeln(p2psocket::log_level::trace, "sending ping with signed message");
+        m_pimpl->writeln(p2psocket::log_level::trace, [&]{ return ping_msg.to_string(); });
 
-        sk.send(item, beltpp::packet(ping_msg));
+        sk.send(item, beltpp::packet(std::move(ping_msg)));
     }
 }
 
+void p2psocket::set_log_level(log_level level)
+{
+    m_pimpl->logging_level = level;
+}
+
+void p2psocket::set_verification_threads(size_t count)
+{
+    if (m_pimpl->verifications &&
+        false == m_pimpl->verifications->idle())
+        throw std::runtime_error("set_verification_threads(): signature checks are pending");
+
+    m_pimpl->verifications.reset();
+    if (0 == count)
+        return;
+
+    beltpp::event_handler* peh = m_pimpl->peh;
+    m_pimpl->verifications.reset(
+                new detail::verification_queue<beltpp::packet>(
+                    count,
+                    count * VERIFICATIONS_PER_THREAD,
+                    [](string const& nodeid, string const& message, string const& signature_b58)
+                    {
+                        return verify_signature(nodeid, message, signature_b58);
+                    },
+                    [peh]
+                    {
+                        peh->wake();
+                    }));
+}
+
+void p2psocket::set_send_queue(bool enabled)
+{
+    m_pimpl->send_queue_enabled = enabled;
+}
+
+void p2psocket::set_send_batching(size_t max_batch)
+{
+    bool changed = (max_batch != m_pimpl->send_batch_size);
+    m_pimpl->send_batch_size = max_batch;
+
+    //  the peers joined after this get it on stream_join
+    if (max_batch >= 2 && changed)
+    {
+        p2pstate& state = *m_pimpl->m_ptr_state.get();
+        for (auto const& item : state.get_connected_peerids())
+            m_pimpl->send_batch_capable(item);
+    }
+}
+
+size_t p2psocket::send_queue_depth(peer_id const& peer) const
+{
+    p2pstate& state = *m_pimpl->m_ptr_state.get();
+    peer_id p2p_peerid;
+
+    if (false == state.get_peer_id(peer, p2p_peerid))
+        throw std::runtime_error("send_queue_depth() no such node: " + peer);
+
+    auto it = m_pimpl->send_queues.find(p2p_peerid);
+    if (it == m_pimpl->send_queues.end())
+        return 0;
+
+    return it->second.size();
+}
+
+string p2psocket::status_summary() const
+{
+    p2pstate& state = *m_pimpl->m_ptr_state.get();
+
+    std::time_t time_t_now = system_clock::to_time_t(system_clock::now());
+    string result = beltpp::gm_time_t_to_lc_string(time_t_now);
+
+    auto connected = state.get_connected_addresses();
+    auto listening = state.get_listening_addresses();
+
+    if (false == connected.empty())
+        result += "\nstatus summary - connected";
+    for (auto const& item : connected)
+        result += "\n    " + item.to_string();
+    if (false == listening.empty())
+        result += "\nstatus summary - listening";
+    for (auto const& item : listening)
+        result += "\n    " + item.to_string();
+
+    result += "\nKBucket list";
+    result += "\n--------";
+    result += "\n" + state.bucket_dump();
+    result += "\n========";
+
+    return result;
+}
+
 string p2psocket::name() const
 {
     p2pstate& state = *m_pimpl->m_ptr_state.get();
@@ -895,21 +1383,56 @@ beltpp::event_item const& p2psocket::worker() const
 
 vector<unordered_set<string>> peers_distance(string const& nodeid, unordered_set<string> const& all_peers)
 {
-    vector<unordered_set<string>> result;
-
-    // init slots
-    for (auto i = 0; i < 20; ++i)
-        result.push_back(unordered_set<string>());
-    
-    // fill peers
-    for (auto const& peer : all_peers)
-    {
-        auto const & distance = contact_actions<Konnection>::distance(nodeid, peer);
-        auto const & index = contact_actions<Konnection>::index_from_distance(distance);
-        
-        if(index < 20)
-            result[index].insert(peer);
-    };
+    vector<string> peers(all_peers.begin(), all_peers.end());
+    vector<node_id_256> peer_ids;
+    peer_ids.reserve(peers.size());
+    for (auto const& peer : peers)
+        peer_ids.push_back(decode_node_id(peer));
+
+    auto slots = peers_distance(decode_node_id(nodeid), peer_ids);
+
+    vector<unordered_set<string>> result(slots.size());
+    for (size_t slot = 0; slot < slots.size(); ++slot)
+    for (size_t index : slots[slot])
+        result[slot].insert(peers[index]);
+
+    return result;
+}
+
+node_id_256 decode_node_id(string const& nodeid)
+{
+    return string_distance(nodeid).value();
+}
+
+vector<vector<size_t>> peers_distance(node_id_256 const& nodeid, vector<node_id_256> const& all_peers)
+{
+    size_t const slot_count = 20;
+    vector<vector<size_t>> result(slot_count);
+
+    //  slots below 20 need the three high words of the distance to be
+    //  zero, so only the lowest word is kept, all ones marks the rest
+    //  the loop is branch free for the compiler to vectorize it
+    vector<uint64_t> low_words(all_peers.size());
+    for (size_t index = 0; index < all_peers.size(); ++index)
+    {
+        auto const& peer = all_peers[index];
+        uint64_t high = (peer[0] ^ nodeid[0]) |
+                        (peer[1] ^ nodeid[1]) |
+                        (peer[2] ^ nodeid[2]);
+        uint64_t low = peer[3] ^ nodeid[3];
+
+        low_words[index] = (high == 0) ? low : uint64_t(-1);
+    }
+
+    for (size_t index = 0; index < low_words.size(); ++index)
+    {
+        uint64_t low = low_words[index];
+        if (low == 0 || low >= (uint64_t(1) << slot_count))
+            continue;
+
+        size_t slot = string_distance(node_id_256{{0, 0, 0, low}}).highest_bit();
+        result[slot].push_back(index);
+    }
 
     return result;
 }
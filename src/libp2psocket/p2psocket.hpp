@@ -10,6 +10,8 @@
 #include <belt.pp/message_global.hpp>
 #include <belt.pp/ilog.hpp>
 
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <list>
@@ -36,6 +38,9 @@ public:
     using packet = beltpp::packet;
     using packets = beltpp::stream::packets;
 
+    //  trace adds per packet and per wait messages
+    enum class log_level {info, trace};
+
     p2psocket(beltpp::event_handler& eh,
               beltpp::ip_address const& bind_to_address,
               std::vector<beltpp::ip_address> const& connect_to_addresses,
@@ -52,9 +57,41 @@ public:
     packets receive(peer_id& peer) override;
 
     void send(peer_id const& peer, packet&& pack) override;
+    //  same packet to each of the peers, the ones that are not known
+    //  are skipped. returns the number of peers it was sent to
+    size_t broadcast(std::vector<peer_id> const& peers, packet&& pack);
 
     void timer_action() override;
 
+    void set_log_level(log_level level);
+
+    //  ping and pong signatures are checked on count worker threads,
+    //  packets of a peer keep their order. a finished check wakes the
+    //  event handler and the next receive() gives the peer's packets.
+    //  0, the default, checks them in receive(). throws if checks are
+    //  still pending
+    void set_verification_threads(size_t count);
+
+    //  send() queues packets per peer and prepare_wait() hands all of
+    //  them to the socket, nothing is dropped. belt.pp does not tell the
+    //  socket backlog, so the depth counts packets sent since the last
+    //  prepare_wait(). false, the default, sends right away
+    void set_send_queue(bool enabled);
+    size_t send_queue_depth(peer_id const& peer) const;
+
+    //  packets sent to a peer during one wait cycle are written as
+    //  OtherBatch messages of up to max_batch, receive() unpacks them.
+    //  with max_batch of 2 or more OtherBatchCapable is sent to each
+    //  peer, nodes older than that message drop the connection on it,
+    //  so enable this once the whole mesh is updated. only peers that
+    //  sent OtherBatchCapable get batches, the rest get each packet on
+    //  its own. 0, the default, writes each packet on its own to everyone
+    void set_send_batching(size_t max_batch);
+
+    //  connected and listening addresses and kbucket counts,
+    //  also written to the log at info level once a minute
+    std::string status_summary() const;
+
     std::string name() const;
 
     beltpp::ip_address external_address() const;
@@ -89,5 +126,15 @@ p2psocket getp2psocket(beltpp::event_handler& eh,
 
 P2PSOCKETSHARED_EXPORT
 std::vector<std::unordered_set<std::string>> peers_distance(std::string const& nodeid, std::unordered_set<std::string> const& all_peers);
+
+//  sha256 of the nodeid as four words, most significant first,
+//  decode once and reuse with the batched peers_distance
+using node_id_256 = std::array<uint64_t, 4>;
+P2PSOCKETSHARED_EXPORT
+node_id_256 decode_node_id(std::string const& nodeid);
+
+//  same slots as above, each holds indices into all_peers
+P2PSOCKETSHARED_EXPORT
+std::vector<std::vector<size_t>> peers_distance(node_id_256 const& nodeid, std::vector<node_id_256> const& all_peers);
 }
 
@@ -1,6 +1,7 @@
 #include "p2pstate.hpp"
 #include <kbucket/konnection.hpp>
 #include <kbucket/kbucket.hpp>
+#include <kbucket/nodelookup.hpp>
 
 #include <libcryptoutility/cryptoutility.hpp>
 
@@ -8,6 +9,8 @@
 #include <boost/functional/hash.hpp>
 
 #include <chrono>
+#include <functional>
+#include <queue>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -30,6 +33,12 @@ using std::string;
 using std::pair;
 using std::unique_ptr;
 
+//  minutes until a verified session has to prove its signature again
+#define REVERIFY_INTERVAL 10
+//  steps a least recently seen contact has to answer the ping sent
+//  to it before eviction, the ping is sent right away
+#define EVICTION_STEPS 2
+
 namespace std
 {
 template <>
@@ -130,37 +139,65 @@ class communication_state
         ip_address address;
     };
     //  end state item
+public:
+    using item_type = state_item;
 private:
-    static void remove_from_set(size_t index, unordered_set<size_t>& set)
+    //  erases the entry only if it still refers to the given slot,
+    //  another slot may have taken over the same key meanwhile
+    template <typename T_map>
+    static void erase_own(T_map& map,
+                          typename T_map::key_type const& key,
+                          size_t index)
     {
-        unordered_set<size_t> set_temp;
-        for (size_t item : set)
-        {
-            if (item > index)
-                set_temp.insert(item - 1);
-            else if (item < index)
-                set_temp.insert(item);
-        }
+        auto it = map.find(key);
+        if (it != map.end() && it->second == index)
+            map.erase(it);
+    }
 
-        set = set_temp;
+    bool removal_due(size_t index) const
+    {
+        auto iter_remove = map_to_remove.find(index);
+        return (iter_remove != map_to_remove.end() &&
+                iter_remove->second.expiry <= current_step);
     }
 
-    template <typename T_map>
-    static void remove_from_map(size_t index, T_map& map)
+    void schedule_remove(size_t index, size_t step, bool send_drop, bool must_notify)
+    {
+        size_t expiry = current_step + step;
+        map_to_remove[index] = to_remove_info{expiry, send_drop, must_notify};
+        expiry_queue.push(std::make_pair(expiry, index));
+    }
+
+    size_t allocate_slot(state_item const& item)
     {
-        auto it = map.begin();
-        while (it != map.end())
+        if (free_slots.empty())
         {
-            size_t& item = it->second;
-            if (item == index)
-                it = map.erase(it);
-            else
-            {
-                if (item > index)
-                    --item;
-                ++it;
-            }
+            peers.emplace_back(item);
+            return peers.size() - 1;
         }
+
+        size_t index = free_slots.back();
+        free_slots.pop_back();
+        peers[index] = item;
+        return index;
+    }
+
+    void free_slot(size_t index)
+    {
+        auto const& stored_item = peers[index].get();
+
+        erase_own(map_by_address, address_key(stored_item.get_address()), index);
+        if (stored_item.state() == state_item::e_state::active)
+            erase_own(map_by_peer_id, stored_item.get_peer(), index);
+        erase_own(map_by_key, stored_item.value.key(), index);
+
+        set_to_connect.erase(index);
+        set_to_listen.erase(index);
+        set_active_connect.erase(index);
+        set_active_listen.erase(index);
+
+        peers[index] = boost::none;
+        free_slots.push_back(index);
     }
 
 public:
@@ -194,16 +231,15 @@ public:
 
         if (it_find != map_by_address.end() &&
             it_find_to_remove != map_to_remove.end() &&
-            it_find_to_remove->second.steps == 0 &&
-            peers[index].state() != state_item::e_state::active)
+            it_find_to_remove->second.expiry <= current_step &&
+            peers[index].get().state() != state_item::e_state::active)
         {
             map_to_remove.erase(it_find_to_remove);
             result = insert_code::fresh;
         }
         else if (it_find == map_by_address.end())
         {
-            peers.emplace_back(item);
-            index = peers.size() - 1;
+            index = allocate_slot(item);
             result = insert_code::fresh;
         }
         else
@@ -220,7 +256,7 @@ public:
 
             item.value = value;
 
-            auto& stored_item = peers[index];
+            auto& stored_item = peers[index].get();
 
             map_by_address.erase(address_key(stored_item.get_address()));
             map_by_key.erase(stored_item.value.key());
@@ -249,7 +285,7 @@ public:
         assert(it_find_addr != map_by_address.end());
 
         size_t index = it_find_addr->second;
-        auto& stored_item = peers[index];
+        auto& stored_item = peers[index].get();
 
         if (stored_item.state() == state_item::e_state::active &&
             p != stored_item.get_peer())
@@ -281,6 +317,17 @@ public:
         map_by_peer_id[p] = index;
         map_by_key[stored_item.value.key()] = index;
 
+        if (stored_item.type() == state_item::e_type::connect)
+        {
+            set_active_listen.erase(index);
+            set_active_connect.insert(index);
+        }
+        else
+        {
+            set_active_connect.erase(index);
+            set_active_listen.insert(index);
+        }
+
         if (add_passive_code == insert_code::old)
             return update_code::updated;
         return update_code::added;
@@ -292,7 +339,7 @@ public:
         if (it_find_peer_id != map_by_peer_id.end())
         {
             size_t index = it_find_peer_id->second;
-            auto& stored_item = peers[index];
+            auto& stored_item = peers[index].get();
 
             if (value.key() != stored_item.value.key())
             {
@@ -314,7 +361,7 @@ public:
         if (it_find_addr != map_by_address.end())
         {
             size_t index = it_find_addr->second;
-            auto& stored_item = peers[index];
+            auto& stored_item = peers[index].get();
 
             if (value.key() != stored_item.value.key())
             {
@@ -336,7 +383,7 @@ public:
         if (it_find_peer_id != map_by_peer_id.end())
         {
             size_t index = it_find_peer_id->second;
-            auto const& stored_item = peers[index];
+            auto const& stored_item = peers[index].get();
 
             value = stored_item.value;
 
@@ -352,7 +399,7 @@ public:
         if (it_find_addr != map_by_address.end())
         {
             size_t index = it_find_addr->second;
-            auto const& stored_item = peers[index];
+            auto const& stored_item = peers[index].get();
 
             value = stored_item.value;
 
@@ -364,11 +411,7 @@ public:
 
     void do_step()
     {
-        for (auto& item : map_to_remove)
-        {
-            if (item.second.steps != 0)
-                --item.second.steps;
-        }
+        ++current_step;
     }
 
     bool remove_later(ip_address const& addr, size_t step, bool send_drop, bool only_if_passive, bool must_notify)
@@ -378,10 +421,10 @@ public:
         {
             auto index = it_find_addr->second;
             if (only_if_passive &&
-                peers[index].state() != state_item::e_state::passive)
+                peers[index].get().state() != state_item::e_state::passive)
                 return false;
 
-            map_to_remove[index] = to_remove_info{step, send_drop, must_notify};
+            schedule_remove(index, step, send_drop, must_notify);
             return true;
         }
         return false;
@@ -392,7 +435,7 @@ public:
         auto it_find_peer_id = map_by_peer_id.find(p);
         if (it_find_peer_id != map_by_peer_id.end())
         {
-            map_to_remove[it_find_peer_id->second] = to_remove_info{step, send_drop, must_notify};
+            schedule_remove(it_find_peer_id->second, step, send_drop, must_notify);
             return true;
         }
         return false;
@@ -416,58 +459,33 @@ public:
              vector<peer_id>> result;
         vector<size_t> indices;
 
-        auto iter_remove = map_to_remove.begin();
-        while (iter_remove != map_to_remove.end())
+        while (false == expiry_queue.empty() &&
+               expiry_queue.top().first <= current_step)
         {
-            auto const& pair_item = *iter_remove;
-            if (pair_item.second.steps != 0)
-            {
-                ++iter_remove;
+            size_t expiry = expiry_queue.top().first;
+            size_t index = expiry_queue.top().second;
+            expiry_queue.pop();
+
+            //  the entry was rescheduled or undone since it was queued
+            auto iter_remove = map_to_remove.find(index);
+            if (iter_remove == map_to_remove.end() ||
+                iter_remove->second.expiry != expiry)
                 continue;
-            }
 
-            size_t index = pair_item.first;
             assert(peers.size() > index);
-            auto const& stored_item = peers[index];
+            auto const& stored_item = peers[index].get();
 
             if (stored_item.value.key() != typename T_value::key_type())
-                result.first.push_back(std::make_pair(stored_item.value.key(), pair_item.second.must_notify));
+                result.first.push_back(std::make_pair(stored_item.value.key(), iter_remove->second.must_notify));
             if (iter_remove->second.send_drop)
                 result.second.push_back(stored_item.get_peer());
 
             indices.push_back(index);
-            iter_remove = map_to_remove.erase(iter_remove);
+            map_to_remove.erase(iter_remove);
         }
 
-        std::sort(indices.begin(), indices.end());
-        for (size_t indices_index = indices.size() - 1;
-             indices_index < indices.size();
-             --indices_index)
-        {
-            size_t index = indices[indices_index];
-
-            //  update map_to_remove keys that are indexes too
-            for (size_t index2 = index + 1; index2 < peers.size(); ++index2)
-            {
-                auto it_find = map_to_remove.find(index2);
-                if (map_to_remove.end() != it_find)
-                {
-                    std::pair<size_t, to_remove_info> insert_item = *it_find;
-                    insert_item.first--;
-                    map_to_remove.insert(insert_item);
-                    map_to_remove.erase(it_find);
-                }
-            }
-
-            peers.erase(peers.begin() + index);
-
-            remove_from_set(index, set_to_connect);
-            remove_from_set(index, set_to_listen);
-
-            remove_from_map(index, map_by_address);
-            remove_from_map(index, map_by_peer_id);
-            remove_from_map(index, map_by_key);
-        }
+        for (size_t index : indices)
+            free_slot(index);
 
         return result;
     }
@@ -482,12 +500,10 @@ public:
             auto index = *it;
             ++it;
 
-            auto iter_remove = map_to_remove.find(index);
-            if (iter_remove != map_to_remove.end() &&
-                iter_remove->second.steps == 0)
+            if (removal_due(index))
                 continue;
 
-            state_item const& stored_item = peers[index];
+            state_item const& stored_item = peers[index].get();
             result.push_back(stored_item.get_address());
         }
 
@@ -504,12 +520,10 @@ public:
             auto index = *it;
             ++it;
 
-            auto iter_remove = map_to_remove.find(index);
-            if (iter_remove != map_to_remove.end() &&
-                iter_remove->second.steps == 0)
+            if (removal_due(index))
                 continue;
 
-            state_item const& stored_item = peers[index];
+            state_item const& stored_item = peers[index].get();
             result.push_back(stored_item.get_address());
         }
 
@@ -532,46 +546,26 @@ public:
         return false;
     }
 
-    vector<state_item> get_connected() const
+    //  visits active connect type items, the ones due for removal
+    //  are skipped, same as get_to_connect() does
+    template <typename T_visitor>
+    void visit_connected(T_visitor&& visitor) const
     {
-        vector<state_item> result;
-
-        for (size_t index = 0; index < peers.size(); ++index)
+        for (size_t index : set_active_connect)
         {
-            auto const& stored_item = peers[index];
-
-            auto iter_remove = map_to_remove.find(index);
-            if (iter_remove != map_to_remove.end() &&
-                iter_remove->second.steps == 0)
-                continue;
-
-            if (stored_item.state() == state_item::e_state::active &&
-                stored_item.type() == state_item::e_type::connect)
-                result.push_back(stored_item);
+            if (false == removal_due(index))
+                visitor(peers[index].get());
         }
-
-        return result;
     }
 
-    vector<state_item> get_listening() const
+    template <typename T_visitor>
+    void visit_listening(T_visitor&& visitor) const
     {
-        vector<state_item> result;
-
-        for (size_t index = 0; index < peers.size(); ++index)
+        for (size_t index : set_active_listen)
         {
-            auto const& stored_item = peers[index];
-
-            auto iter_remove = map_to_remove.find(index);
-            if (iter_remove != map_to_remove.end() &&
-                iter_remove->second.steps == 0)
-                continue;
-
-            if (stored_item.state() == state_item::e_state::active &&
-                stored_item.type() == state_item::e_type::listen)
-                result.push_back(stored_item);
+            if (false == removal_due(index))
+                visitor(peers[index].get());
         }
-
-        return result;
     }
 
     bool get_peer_id(ip_address const& addr, peer_id& p)
@@ -581,7 +575,7 @@ public:
         {
             size_t index = it_find_addr->second;
 
-            p = peers[index].get_peer();
+            p = peers[index].get().get_peer();
             return true;
         }
         return false;
@@ -594,27 +588,37 @@ public:
         {
             size_t index = it_find_peer_id->second;
 
-            addr = peers[index].get_address();
+            addr = peers[index].get().get_address();
             return true;
         }
         return false;
     }
 
-    vector<state_item> peers;
+    //  slots are stable, removed ones are reused from free_slots
+    vector<optional<state_item>> peers;
+    vector<size_t> free_slots;
     unordered_map<ip_destination, size_t> map_by_address;
     unordered_map<peer_id, size_t> map_by_peer_id;
     unordered_map<typename T_value::key_type, size_t> map_by_key;
     unordered_set<size_t> set_to_listen;
     unordered_set<size_t> set_to_connect;
+    unordered_set<size_t> set_active_listen;
+    unordered_set<size_t> set_active_connect;
 
     struct to_remove_info
     {
-        size_t steps;
+        size_t expiry;
         bool send_drop;
         bool must_notify;
     };
 
+    //  removal is due when current_step reaches expiry, expiry_queue
+    //  may hold outdated entries, map_to_remove is the one to trust
+    size_t current_step = 0;
     unordered_map<size_t, to_remove_info> map_to_remove;
+    std::priority_queue<pair<size_t, size_t>,
+                        vector<pair<size_t, size_t>>,
+                        std::greater<pair<size_t, size_t>>> expiry_queue;
 };
 
 class p2pstate_ex : public meshpp::p2pstate
@@ -665,6 +669,36 @@ public:
     void do_step() override
     {
         program_state.do_step();
+
+        ++current_step;
+        while (false == eviction_queue.empty() &&
+               eviction_queue.top().first <= current_step)
+        {
+            size_t deadline = eviction_queue.top().first;
+            string nodeid = eviction_queue.top().second;
+            eviction_queue.pop();
+
+            //  the contact was seen or removed since it was queued
+            auto it = pending_evictions.find(nodeid);
+            if (it == pending_evictions.end() ||
+                it->second != deadline)
+                continue;
+
+            pending_evictions.erase(it);
+
+            //  least recently seen contact did not show up in time,
+            //  its place is given to the latest replacement
+            auto it_find = kbucket.find(Konnection(nodeid));
+            if (it_find != kbucket.end())
+            {
+                peer_id evicted_peer = it_find->get_peer();
+                kbucket.erase(it_find);
+                peer_by_nodeid.erase(nodeid);
+                program_state.remove_later(evicted_peer, 0, true, true);
+            }
+        }
+
+        collect_promoted();
     }
 
     contact_status add_contact(peer_id const& peerid, string const& nodeid) override
@@ -672,11 +706,57 @@ public:
         Konnection k{nodeid, peerid};
 
         if (kbucket.find(k) != kbucket.end())
+        {
+            contact_seen(nodeid);
             return contact_status::existing_contact;
-        else if (kbucket.insert(k).second)
+        }
+
+        auto insert_result = kbucket.insert(k);
+        if (insert_result.second)
+        {
+            peer_by_nodeid[nodeid] = peerid;
             return contact_status::new_contact;
-        else
-            return contact_status::no_contact;
+        }
+
+        if (kbucket.add_replacement(k))
+        {
+            //  ping before evict, the least recently seen one is pinged
+            //  and has EVICTION_STEPS to prove it is alive
+            string lrs_nodeid = insert_result.first->to_string();
+            if (0 == pending_evictions.count(lrs_nodeid))
+            {
+                pending_evictions[lrs_nodeid] = current_step + EVICTION_STEPS;
+                eviction_queue.push(std::make_pair(current_step + EVICTION_STEPS, lrs_nodeid));
+                eviction_probes.push_back(insert_result.first->get_peer());
+            }
+
+            return contact_status::replacement_contact;
+        }
+
+        return contact_status::no_contact;
+    }
+
+    void contact_seen(string const& nodeid) override
+    {
+        if (nodeid.empty())
+            return;
+
+        kbucket.touch(Konnection(nodeid));
+        pending_evictions.erase(nodeid);
+    }
+
+    vector<string> take_promoted_contacts() override
+    {
+        vector<string> result;
+        result.swap(promoted_nodeids);
+        return result;
+    }
+
+    vector<peer_id> take_eviction_probes() override
+    {
+        vector<peer_id> result;
+        result.swap(eviction_probes);
+        return result;
     }
 
     bool contacts_empty() const override
@@ -705,9 +785,10 @@ public:
     {
         vector<peer_id> result;
 
-        auto connected = program_state.get_connected();
-        for (auto const& item : connected)
+        program_state.visit_connected([&result](decltype(program_state)::item_type const& item)
+        {
             result.push_back(item.get_peer());
+        });
 
         return result;
     }
@@ -715,9 +796,10 @@ public:
     {
         vector<ip_address> result;
 
-        auto connected = program_state.get_connected();
-        for (auto const& item : connected)
+        program_state.visit_connected([&result](decltype(program_state)::item_type const& item)
+        {
             result.push_back(item.get_address());
+        });
 
         return result;
     }
@@ -725,9 +807,10 @@ public:
     {
         vector<ip_address> result;
 
-        auto connected = program_state.get_listening();
-        for (auto const& item : connected)
+        program_state.visit_listening([&result](decltype(program_state)::item_type const& item)
+        {
             result.push_back(item.get_address());
+        });
 
         return result;
     }
@@ -789,24 +872,29 @@ public:
         auto to_remove = program_state.remove_pending();
 
         for (auto const& key_item : to_remove.first)
+        {
             kbucket.erase(Konnection(key_item.first));
+            peer_by_nodeid.erase(key_item.first);
+            pending_evictions.erase(key_item.first);
+        }
+
+        collect_promoted();
 
         return to_remove;
     }
 
- //   vector<string> list_nearest_to(string const& nodeid) override
- //   {
- //       Konnection k(nodeid);
- //       //auto tmp_bucket = kbucket.rebase(k, false);
- //       auto konnections = kbucket.list_nearests_to(k, false);
- //
- //       vector<string> result;
- //
- //       for (Konnection const& konnection_item : konnections)
- //           result.push_back(konnection_item.to_string());
- //
- //       return result;
- //   }
+    vector<string> list_nearest_to(string const& nodeid) override
+    {
+        auto konnections = kbucket.list_nearests_to(Konnection(nodeid));
+
+        vector<string> result;
+        result.reserve(konnections.size());
+
+        for (Konnection const& konnection_item : konnections)
+            result.push_back(konnection_item.to_string());
+
+        return result;
+    }
 
     vector<string> get_kbucket_nodeids() const override
     {
@@ -815,21 +903,49 @@ public:
     
     vector<string> filter_introduce_candidates(vector<string> const& nodeids) override
     {
-        vector<string> result;
+        //  the lookup for own nodeid is restarted once it completes,
+        //  so that nodes joining later are still found
+        if (nullptr == node_lookup || node_lookup->is_complete())
+        {
+            node_lookup.reset(new NodeLookup(Konnection{SelfID}));
+            node_lookup->add_probed(kbucket.list_nearests_to(Konnection{SelfID}));
+        }
 
+        vector<Konnection> konnections;
         for (auto const& nodeid : nodeids)
         {
             if (nodeid == SelfID)   // skip ourself if it happens
                 continue;
 
-            Konnection _konnection{ nodeid };
+            konnections.push_back(Konnection{ nodeid });
+        }
+
+        node_lookup->add_konnections(konnections);
+
+        //  up to alpha nodes closest to us, from the lookup, and any node
+        //  whose bucket has room, so that the far buckets are filled too
+        vector<Konnection> candidates = node_lookup->next_probes();
+        for (auto const& _konnection : konnections)
+        {
+            if (kbucket.has_room_for(_konnection))
+                candidates.push_back(_konnection);
+        }
+
+        vector<string> result;
+        unordered_set<string> seen;
+        for (auto const& _konnection : candidates)
+        {
+            string nodeid = _konnection.to_string();
+            if (false == seen.insert(nodeid).second)
+                continue;
+
             if (kbucket.end() == kbucket.find(_konnection))
             {
                 auto it = droped_nodes.find(nodeid);
                 if (it != droped_nodes.end() && it->second.second < it->second.first)
                     ++it->second.second; // skip
                 else
-                    result.push_back(_konnection.to_string()); // try to connect
+                    result.push_back(nodeid); // try to connect
             }
         }
 
@@ -846,12 +962,10 @@ public:
 
     bool get_peer_id(string const& nodeid, peer_id& peerid) override
     {
-        Konnection k_nodeid(nodeid);
-        auto it_find = kbucket.find(k_nodeid);
-        if (it_find != kbucket.end())
+        auto it_find = peer_by_nodeid.find(nodeid);
+        if (it_find != peer_by_nodeid.end())
         {
-            auto k = Konnection(*it_find);
-            peerid = k.get_peer();
+            peerid = it_find->second;
             return true;
         }
         return false;
@@ -859,17 +973,7 @@ public:
 
     bool process_introduce_request(string const& nodeid, peer_id& peerid) override
     {
-        Konnection msg_konnection(nodeid);
-        auto it_find = kbucket.find(msg_konnection);
-        if (it_find != kbucket.end())
-        {
-            msg_konnection = Konnection(*it_find);
-            peerid = msg_konnection.get_peer();
-
-            return true;
-        }
-
-        return false;
+        return get_peer_id(nodeid, peerid);
     }
 
     string bucket_dump() override
@@ -884,9 +988,21 @@ public:
         return verified_peers.count(peerid) > 0;
     }
 
-    void set_peer_verified(peer_id const& peerid) override
+    bool is_peer_verified(peer_id const& peerid, string const& nodeid) override
     {
-        verified_peers.insert(peerid);
+        auto it_find = verified_peers.find(peerid);
+        if (it_find == verified_peers.end() ||
+            it_find->second.nodeid != nodeid)
+            return false;
+
+        return steady_clock::now() - it_find->second.verified < chrono::minutes(REVERIFY_INTERVAL);
+    }
+
+    void set_peer_verified(peer_id const& peerid, string const& nodeid) override
+    {
+        auto& item = verified_peers[peerid];
+        item.nodeid = nodeid;
+        item.verified = steady_clock::now();
     }
 
     void set_peer_unverified(peer_id const& peerid) override
@@ -921,16 +1037,46 @@ public:
     }
 
 private:
+    void collect_promoted()
+    {
+        for (auto const& konnection : kbucket.take_promoted())
+        {
+            //  from now on its drop has to be announced too
+            program_state.remove_later(konnection.get_peer(), 10, true, true);
+            peer_by_nodeid[konnection.to_string()] = konnection.get_peer();
+            promoted_nodeids.push_back(konnection.to_string());
+        }
+    }
+
     unsigned short fixed_local_port;
     beltpp::ip_address external_ip_address;
     string SelfID;
     KBucket<Konnection> kbucket;
-    //  node lookup design is wrong, does not fit in
-    //unique_ptr<NodeLookup> node_lookup;
+    //  peers of the kbucket contacts, saves hashing the nodeid on each send.
+    //  changed only together with the kbucket, so it holds the same peers
+    unordered_map<string, peer_id> peer_by_nodeid;
+    unique_ptr<NodeLookup> node_lookup;
     communication_state<peer_state> program_state;
 
-    unordered_set<peer_id> verified_peers;
+    class verified_session
+    {
+    public:
+        string nodeid;
+        steady_clock::time_point verified;
+    };
+
+    unordered_map<peer_id, verified_session> verified_peers;
     unordered_map<string, pair<size_t, size_t>> droped_nodes;
+
+    size_t current_step = 0;
+    //  same lazy scheme as communication_state::expiry_queue,
+    //  pending_evictions is the one to trust
+    unordered_map<string, size_t> pending_evictions;
+    std::priority_queue<pair<size_t, string>,
+                        vector<pair<size_t, string>>,
+                        std::greater<pair<size_t, string>>> eviction_queue;
+    vector<string> promoted_nodeids;
+    vector<peer_id> eviction_probes;
 };
 
 namespace meshpp
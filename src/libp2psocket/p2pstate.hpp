@@ -18,7 +18,9 @@ class p2pstate
 public:
     enum class insert_code {old, fresh};
     enum class update_code {updated, added};
-    enum class contact_status {no_contact, new_contact, existing_contact};
+    //  replacement_contact did not fit in the full kbucket, it is kept
+    //  connected and may be promoted to a contact later
+    enum class contact_status {no_contact, new_contact, existing_contact, replacement_contact};
 
     virtual ~p2pstate() {}
     virtual std::string name() const = 0;
@@ -36,6 +38,13 @@ public:
                                        std::string const& nodeid) = 0;
 
     virtual bool contacts_empty() const = 0;
+    //  a contact proved to be alive, it will not be evicted for now
+    virtual void contact_seen(std::string const& nodeid) = 0;
+    //  replacement nodes that became contacts since last call
+    virtual std::vector<std::string> take_promoted_contacts() = 0;
+    //  least recently seen contacts to ping now, a replacement takes
+    //  the place of the ones that do not answer in time
+    virtual std::vector<beltpp::socket::peer_id> take_eviction_probes() = 0;
 
     virtual void set_active_nodeid(beltpp::socket::peer_id const& peer_id,
                                    std::string const& nodeid) = 0;
@@ -71,7 +80,8 @@ public:
     //  has to take care of kbucket clean up
     virtual std::pair<std::vector<std::pair<std::string, bool>>, std::vector<beltpp::socket::peer_id>> remove_pending() = 0;
 
-    //virtual std::vector<std::string> list_nearest_to(std::string const& nodeid) = 0;
+    //  kbucket contacts closest to the nodeid, at most K of them
+    virtual std::vector<std::string> list_nearest_to(std::string const& nodeid) = 0;
     virtual std::vector<std::string> get_kbucket_nodeids() const = 0; // probably name is not the best
     
     virtual std::vector<std::string> filter_introduce_candidates(std::vector<std::string> const& nodeids) = 0;
@@ -84,7 +94,12 @@ public:
     virtual std::string bucket_dump() = 0;
 
     virtual bool is_peer_verified(beltpp::socket::peer_id const& peerid) = 0;
-    virtual void set_peer_verified(beltpp::socket::peer_id const& peerid) = 0;
+    //  true if the session was verified for this nodeid not earlier than
+    //  the re-verification interval, the signature check can be skipped
+    virtual bool is_peer_verified(beltpp::socket::peer_id const& peerid,
+                                  std::string const& nodeid) = 0;
+    virtual void set_peer_verified(beltpp::socket::peer_id const& peerid,
+                                   std::string const& nodeid) = 0;
     virtual void set_peer_unverified(beltpp::socket::peer_id const& peerid) = 0;
 
     virtual void process_node_join(std::string const& nodeid) = 0;
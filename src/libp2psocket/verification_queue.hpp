@@ -0,0 +1,224 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace meshpp
+{
+namespace detail
+{
+//  signatures are checked on a fixed set of worker threads. the item
+//  being checked and the ones received from the same peer after it are
+//  parked until the check is done, so that the peer's order is kept.
+//  wake is called from the worker thread when a check is done
+template <typename T_item>
+class verification_queue
+{
+public:
+    using peer_id = std::string;
+    using verify_function = std::function<bool(std::string const& nodeid,
+                                               std::string const& message,
+                                               std::string const& signature)>;
+    using wake_function = std::function<void()>;
+
+    class result
+    {
+    public:
+        peer_id peer;
+        std::string nodeid;
+        bool ping = false;
+        bool verified = false;
+    };
+
+    verification_queue(size_t threads,
+                       size_t max_pending_,
+                       verify_function const& verify_,
+                       wake_function const& wake_)
+        : max_pending(max_pending_)
+        , pending(0)
+        , stopping(false)
+        , verify(verify_)
+        , wake(wake_)
+    {
+        for (size_t index = 0; index < threads; ++index)
+            workers.push_back(std::thread([this]{ work(); }));
+    }
+
+    ~verification_queue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    verification_queue(verification_queue const&) = delete;
+    verification_queue& operator = (verification_queue const&) = delete;
+
+    //  the caller checks the signature itself then
+    bool full() const
+    {
+        return pending >= max_pending;
+    }
+
+    //  no check is running and no item is parked
+    bool idle() const
+    {
+        return 0 == pending && parked.empty();
+    }
+
+    //  false if there are max_pending checks already
+    bool verify_later(peer_id const& peer,
+                      bool ping,
+                      std::string const& nodeid,
+                      std::string const& message,
+                      std::string const& signature,
+                      T_item&& item)
+    {
+        if (full())
+            return false;
+
+        job new_job;
+        new_job.peer = peer;
+        new_job.nodeid = nodeid;
+        new_job.ping = ping;
+        new_job.message = message;
+        new_job.signature = signature;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(new_job));
+        }
+        condition.notify_one();
+
+        ++pending;
+        parked[peer].push_back(std::move(item));
+        return true;
+    }
+
+    bool is_parked(peer_id const& peer) const
+    {
+        return parked.count(peer) > 0;
+    }
+
+    void park(peer_id const& peer, T_item&& item)
+    {
+        parked[peer].push_back(std::move(item));
+    }
+
+    //  the peer is gone, its check result will be ignored
+    void forget(peer_id const& peer)
+    {
+        parked.erase(peer);
+    }
+
+    //  the first finished check of a peer that is still around, with the
+    //  items parked for it in the order they came. the first of them is
+    //  the one the check was for
+    bool take(result& taken, std::deque<T_item>& items)
+    {
+        while (true)
+        {
+            result done_item;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (done.empty())
+                    return false;
+
+                done_item = std::move(done.front());
+                done.pop_front();
+            }
+            --pending;
+
+            auto it_parked = parked.find(done_item.peer);
+            if (it_parked == parked.end())
+                continue;   //  the peer is gone already
+
+            taken = std::move(done_item);
+            items = std::move(it_parked->second);
+            parked.erase(it_parked);
+
+            return true;
+        }
+    }
+
+private:
+    class job
+    {
+    public:
+        peer_id peer;
+        std::string nodeid;
+        bool ping = false;
+        std::string message;
+        std::string signature;
+    };
+
+    void work()
+    {
+        while (true)
+        {
+            job current;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]{ return stopping || false == jobs.empty(); });
+                if (stopping)
+                    return;
+
+                current = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            result checked;
+            checked.peer = current.peer;
+            checked.nodeid = current.nodeid;
+            checked.ping = current.ping;
+            //  a malformed nodeid throws, same as a bad signature
+            try
+            {
+                checked.verified = verify(current.nodeid,
+                                          current.message,
+                                          current.signature);
+            }
+            catch (...)
+            {
+                checked.verified = false;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.push_back(std::move(checked));
+            }
+
+            if (wake)
+                wake();
+        }
+    }
+
+    //  owned by the thread that calls verify_later() and take()
+    size_t max_pending;
+    size_t pending;
+    std::unordered_map<peer_id, std::deque<T_item>> parked;
+
+    //  shared with the workers
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+    std::deque<job> jobs;
+    std::deque<result> done;
+
+    verify_function verify;
+    wake_function wake;
+    std::vector<std::thread> workers;
+};
+}
+}
@@ -4,9 +4,13 @@
 #include "processutility.hpp"
 #include "data.hpp"
 
+#include <mesh.pp/cryptopp_byte.hpp>
+
 #include <belt.pp/utility.hpp>
 #include <belt.pp/scope_helper.hpp>
 
+#include <cryptopp/zlib.h>
+
 #ifdef B_OS_WINDOWS
 #include <windows.h>
 static_assert(sizeof(intptr_t) == sizeof(HANDLE), "check the sizes");
@@ -22,6 +26,8 @@ static_assert(sizeof(intptr_t) >= sizeof(int), "check the sizes");
 
 #endif
 
+#include <atomic>
+#include <algorithm>
 #include <chrono>
 #include <thread>
 #include <utility>
@@ -29,6 +35,7 @@ static_assert(sizeof(intptr_t) >= sizeof(int), "check the sizes");
 #include <unordered_map>
 #include <unordered_set>
 #include <future>
+#include <mutex>
 
 using std::string;
 using std::vector;
@@ -169,6 +176,132 @@ void dostuff(intptr_t native_handle, boost::filesystem::path const& path)
         throw std::runtime_error("unable to write to lock file: " + path.string());
 }
 
+class loader_stats_counters
+{
+public:
+    std::atomic<bool> enabled{false};
+    std::atomic<uint64_t> bytes_read{0};
+    std::atomic<uint64_t> bytes_written{0};
+    std::atomic<uint64_t> files_opened{0};
+    std::atomic<uint64_t> copy_file_bytes{0};
+    std::atomic<uint64_t> compaction_bytes_moved{0};
+    std::atomic<uint64_t> commit_count{0};
+    std::atomic<uint64_t> rollback_count{0};
+    std::atomic<uint64_t> parse_time{0};
+    std::atomic<uint64_t> serialize_time{0};
+    std::atomic<uint64_t> commit_time{0};
+    std::atomic<uint64_t> rollback_time{0};
+
+    loader_stats snapshot() const noexcept
+    {
+        loader_stats result;
+        result.bytes_read = bytes_read.load();
+        result.bytes_written = bytes_written.load();
+        result.files_opened = files_opened.load();
+        result.copy_file_bytes = copy_file_bytes.load();
+        result.compaction_bytes_moved = compaction_bytes_moved.load();
+        result.commit_count = commit_count.load();
+        result.rollback_count = rollback_count.load();
+        result.parse_time = std::chrono::nanoseconds(parse_time.load());
+        result.serialize_time = std::chrono::nanoseconds(serialize_time.load());
+        result.commit_time = std::chrono::nanoseconds(commit_time.load());
+        result.rollback_time = std::chrono::nanoseconds(rollback_time.load());
+        return result;
+    }
+
+    void reset() noexcept
+    {
+        for (auto counter : {&bytes_read, &bytes_written, &files_opened,
+                             &copy_file_bytes, &compaction_bytes_moved,
+                             &commit_count, &rollback_count,
+                             &parse_time, &serialize_time,
+                             &commit_time, &rollback_time})
+            counter->store(0);
+    }
+};
+
+using stats_counter = std::atomic<uint64_t> loader_stats_counters::*;
+
+//  pstats can be nullptr, for loaders used outside of a container
+inline bool stats_enabled(loader_stats_counters const* pstats) noexcept
+{
+    return pstats && pstats->enabled.load(std::memory_order_relaxed);
+}
+
+inline void stats_add(loader_stats_counters* pstats,
+                      stats_counter counter,
+                      uint64_t value) noexcept
+{
+    if (stats_enabled(pstats))
+        (pstats->*counter).fetch_add(value, std::memory_order_relaxed);
+}
+
+//  accumulates the lifetime of the object in nanoseconds
+class stats_timer
+{
+public:
+    stats_timer(loader_stats_counters* pstats_, stats_counter counter_) noexcept
+        : pstats(stats_enabled(pstats_) ? pstats_ : nullptr)
+        , counter(counter_)
+        , start()
+    {
+        if (pstats)
+            start = std::chrono::steady_clock::now();
+    }
+    ~stats_timer()
+    {
+        if (pstats)
+        {
+            auto duration = std::chrono::steady_clock::now() - start;
+            (pstats->*counter).fetch_add(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()),
+                                         std::memory_order_relaxed);
+        }
+    }
+    stats_timer(stats_timer const&) = delete;
+    stats_timer& operator = (stats_timer const&) = delete;
+private:
+    loader_stats_counters* pstats;
+    stats_counter counter;
+    std::chrono::steady_clock::time_point start;
+};
+
+//  serialized values never start with this byte
+char const compressed_record_tag = '\x01';
+
+string compress_record(string const& buffer)
+{
+    string result(1, compressed_record_tag);
+    CryptoPP::StringSource ss(buffer, true,
+                              new CryptoPP::ZlibCompressor(new CryptoPP::StringSink(result), 1));
+
+    //  small records may not get any shorter
+    if (result.size() >= buffer.size())
+        return buffer;
+    return result;
+}
+
+string decompress_record(string const& buffer,
+                         boost::filesystem::path const& path)
+{
+    if (buffer.empty() || buffer[0] != compressed_record_tag)
+        return buffer;
+
+    string result;
+    try
+    {
+        CryptoPP::StringSource ss(reinterpret_cast<CryptoPP::byte const*>(&buffer[1]),
+                                  buffer.size() - 1,
+                                  true,
+                                  new CryptoPP::ZlibDecompressor(new CryptoPP::StringSink(result)));
+    }
+    catch (std::exception const& ex)
+    {
+        throw std::runtime_error("invalid compressed record in: " + path.string() + " - " + ex.what());
+    }
+
+    return result;
+}
+
 template <typename T_key,
           typename T,
           void(T::*from_string)(string const&, void*),
@@ -307,13 +440,17 @@ public:
                       vector<T_key> const& keys,
                       void* putl_ = nullptr,
                       detail::ptr_transaction&& ptransaction_ = detail::null_ptr_transaction(),
-                      bool purpose_clear = false)
+                      bool purpose_clear = false,
+                      loader_stats_counters* pstats_ = nullptr,
+                      value_compression compression_ = value_compression::none)
         : modified(false)
         , purpose_clear_all(false)
         , ptransaction(std::move(ptransaction_))
         , main_path(path)
         , values()
         , putl(putl_)
+        , pstats(pstats_)
+        , compression(compression_)
     {
         beltpp::on_failure guard([this, &ptransaction_]()
         {
@@ -339,9 +476,12 @@ public:
         }
 
         load_file(marker_path, fl, begin, end);
+        if (fl)
+            stats_add(pstats, &loader_stats_counters::files_opened, 1);
         if (begin != end)
         {
             vector<char> buf_markers(begin, end);
+            stats_add(pstats, &loader_stats_counters::bytes_read, buf_markers.size());
             if (0 != buf_markers.size() % (3 * sizeof(uint64_t)))
                 throw std::runtime_error("invalid marker file size: " + marker_path.string());
 
@@ -365,6 +505,8 @@ public:
         std::istreambuf_iterator<char> end_contents, begin_contents;
         boost::filesystem::ifstream fl_contents;
         load_file(contents_path, fl_contents, begin_contents, end_contents);
+        if (fl_contents)
+            stats_add(pstats, &loader_stats_counters::files_opened, 1);
         bool contents_exist = (begin_contents != end_contents);
 
         bool load_all = keys.empty();
@@ -415,9 +557,13 @@ public:
                       "read",
                       std::to_string(item.start) + "-" + std::to_string(item.end),
                       string());
+                stats_add(pstats, &loader_stats_counters::bytes_read, row.size());
 
                 value new_value;
-                new_value.item.from_string(row, putl);
+                {
+                    stats_timer timer(pstats, &loader_stats_counters::parse_time);
+                    new_value.item.from_string(decompress_record(row, contents_path), putl);
+                }
 
                 typename unordered_map<T_key, bool>::iterator it_key;
                 if (false == load_all)
@@ -462,6 +608,8 @@ public:
         , values(std::move(other.values))
         , putl(std::move(other.putl))
         , markers(std::move(markers))
+        , pstats(other.pstats)
+        , compression(other.compression)
     {
         if (nullptr != ptransaction &&
             nullptr == dynamic_cast<class_transaction*>(ptransaction.get()))
@@ -482,6 +630,8 @@ public:
         values = std::move(other.values);
         putl = std::move(other.putl);
         markers = std::move(other.markers);
+        pstats = other.pstats;
+        compression = other.compression;
 
         return *this;
     }
@@ -519,6 +669,20 @@ public:
         auto start_pos = size_t(-1);
         string bulk_buffer;
 
+        //  the sizes the values had when loaded are a good guess, so that
+        //  the buffer does not need to grow while appending. after a save
+        //  the indices may be off, those are only a guess too
+        size_t bulk_size = 0;
+        for (auto const& value : values)
+        {
+            if (value.second.loaded_marker_index < markers.size())
+            {
+                auto const& item = markers[value.second.loaded_marker_index];
+                bulk_size += item.end - item.start;
+            }
+        }
+        bulk_buffer.reserve(bulk_size);
+
         unordered_set<size_t> erase_indices;
 
         beltpp::on_failure guard_file_tr;
@@ -528,6 +692,9 @@ public:
             boost::system::error_code ec;
             if (boost::filesystem::exists(file_path()))
             {
+                if (stats_enabled(pstats))
+                    stats_add(pstats, &loader_stats_counters::copy_file_bytes,
+                              boost::filesystem::file_size(file_path(), ec));
                 boost::filesystem::copy_file(file_path(),
                                              file_path_tr(),
                                              boost::filesystem::copy_options::overwrite_existing,
@@ -541,7 +708,13 @@ public:
 
         for (auto& value : values)
         {
-            string const buffer = value.second.item.to_string();
+            string buffer;
+            {
+                stats_timer timer(pstats, &loader_stats_counters::serialize_time);
+                buffer = value.second.item.to_string();
+                if (compression == value_compression::zlib)
+                    buffer = compress_record(buffer);
+            }
 
             //  will append this item in the end of file
             auto seek_pos = size_t(0);
@@ -583,6 +756,7 @@ public:
         guard_file_tr.dismiss();
         guard_file_tr = beltpp::on_failure([this]{ boost::filesystem::remove(file_path_tr()); });
 
+        if (false == bulk_buffer.empty())
         {
             boost::filesystem::fstream fl;
             fl.open(file_path_tr(), std::ios_base::binary |
@@ -591,7 +765,7 @@ public:
 
             if (!fl)
                 throw std::runtime_error("save(): unable to open fstream: " + file_path_tr().string());
-
+            stats_add(pstats, &loader_stats_counters::files_opened, 1);
 
             fl.seekg(0, std::ios_base::end);
             check(fl, file_path_tr(), "save", "seekg", "end", string());
@@ -607,6 +781,7 @@ public:
             check(fl, file_path_tr(), "save", "write",
                   std::to_string(start_pos) + "-" + std::to_string(start_pos + bulk_buffer.size()),
                   "opened size: " + std::to_string(size_when_opened));
+            stats_add(pstats, &loader_stats_counters::bytes_written, bulk_buffer.size());
 
             fl.close();
             check(fl, file_path_tr(), "save", "close", "all", string());
@@ -657,6 +832,9 @@ public:
             false == markers.empty())
         {
             boost::system::error_code ec;
+            if (stats_enabled(pstats))
+                stats_add(pstats, &loader_stats_counters::copy_file_bytes,
+                          boost::filesystem::file_size(file_path(), ec));
             boost::filesystem::copy_file(file_path(),
                                          file_path_tr(),
                                          boost::filesystem::copy_options::overwrite_existing,
@@ -743,6 +921,7 @@ private:
 
             if (!fl)
                 throw std::runtime_error("compact(): unable to open fstream: " + file_path_tr().string());
+            stats_add(pstats, &loader_stats_counters::files_opened, 1);
 
             fl.seekg(0, std::ios_base::end);
             check(fl, file_path_tr(), "compact", "seekg", "end", string());
@@ -760,6 +939,7 @@ private:
 
             if (!fl)
                 throw std::runtime_error("compact(): unable to open fstream: " + file_path_tr().string());
+            stats_add(pstats, &loader_stats_counters::files_opened, 1);
 
             auto markers_copy = markers;
             size_t write_index = 0;
@@ -829,6 +1009,7 @@ private:
                     check(fl, file_path_tr(), "compact", "write",
                           std::to_string(item.start) + "-" + std::to_string(item.end),
                           "opened size: " + std::to_string(size_when_opened));
+                    stats_add(pstats, &loader_stats_counters::compaction_bytes_moved, buffer.size());
                 }
 
                 start = item.end;
@@ -884,6 +1065,7 @@ private:
                                         std::ios_base::trunc);
         if (!ofl)
             throw std::runtime_error("save_markers(): unable to open fstream: " + file_path_marker_tr().string());
+        stats_add(pstats, &loader_stats_counters::files_opened, 1);
 
         beltpp::on_failure guard_file_marker_tr([this]{ boost::filesystem::remove(file_path_marker_tr()); });
 
@@ -893,6 +1075,7 @@ private:
         {
             ofl.write(reinterpret_cast<char const*>(&markers.front().start), int64_t(sizeof(marker) * markers.size()));
             check(ofl, file_path_marker_tr(), "save_markers", "write", "all", string());
+            stats_add(pstats, &loader_stats_counters::bytes_written, sizeof(marker) * markers.size());
         }
 
         ofl.close();
@@ -930,6 +1113,8 @@ private:
     unordered_map<T_key, value> values;
     void* putl;
     vector<marker> markers;
+    loader_stats_counters* pstats;
+    value_compression compression;
 };
 
 unordered_map<string, string> load_index(string const& name,
@@ -965,13 +1150,313 @@ unordered_map<string, string> load_index(string const& name,
     return index;
 }
 
+string bucket_filename(string const& name, size_t number)
+{
+    string strh = std::to_string(number);
+    while (strh.length() < 4)
+        strh = "0" + strh;
+
+    return name + "." + strh;
+}
+
+using hits_loader = block_file_loader<string,
+                                      Data::StringBlockItem,
+                                      &Data::StringBlockItem::from_string,
+                                      &Data::StringBlockItem::to_string>;
+
+unordered_map<string, uint64_t> load_file_hits(string const& name,
+                                               boost::filesystem::path const& path)
+{
+    auto ptr_utl = meshpp::detail::get_putl();
+
+    unordered_map<string, uint64_t> hits;
+
+    hits_loader
+            temp(path / (name + ".hits"),
+                 vector<string>(),
+                 ptr_utl.get(),
+                 detail::null_ptr_transaction());
+    unordered_set<string> keys;
+    if (temp.loaded(keys))
+    {
+        for (auto const& key : keys)
+        {
+            Data::UInt64Value item;
+            std::move(temp[key].item).get(item);
+
+            hits[key] = item.value;
+        }
+    }
+
+    return hits;
+}
+
+//  adds the access counts collected since the last save to the stored
+//  ones, the file is written within the transaction of the container.
+//  the counts written are kept in pending_hits until the transaction ends
+template <typename class_transaction>
+void save_file_hits(string const& name,
+                    boost::filesystem::path const& path,
+                    unordered_map<string, uint64_t>& session_hits,
+                    unordered_map<string, uint64_t>& pending_hits,
+                    class_transaction& ref_class_transaction,
+                    void* putl,
+                    loader_stats_counters* pstats)
+{
+    if (session_hits.empty())
+        return;
+
+    vector<string> keys;
+    for (auto const& item : session_hits)
+        keys.push_back(item.first);
+
+    auto& ref_ptransaction =
+            ref_class_transaction.overlay.insert(
+                std::make_pair(name + ".hits", detail::null_ptr_transaction())).first->second;
+
+    hits_loader
+            temp(path / (name + ".hits"),
+                 keys,
+                 putl,
+                 std::move(ref_ptransaction),
+                 false,
+                 pstats);
+
+    beltpp::finally guard([&ref_ptransaction, &temp]
+    {
+        ref_ptransaction = std::move(temp.transaction());
+    });
+
+    for (auto const& item : session_hits)
+    {
+        Data::UInt64Value value;
+        value.value = item.second;
+
+        auto& stored = temp[item.first].item;
+        if (stored.type() == Data::UInt64Value::rtt)
+        {
+            Data::UInt64Value stored_value;
+            stored.get(stored_value);
+            value.value += stored_value.value;
+        }
+
+        stored.set(std::move(value));
+    }
+
+    temp.save();
+
+    for (auto const& item : session_hits)
+        pending_hits[item.first] += item.second;
+    session_hits.clear();
+}
+
+//  a rolled back transaction does not undo the reads, the counts it
+//  was going to write are saved again with the next transaction
+void restore_file_hits(unordered_map<string, uint64_t>& session_hits,
+                       unordered_map<string, uint64_t>& pending_hits)
+{
+    for (auto const& item : pending_hits)
+        session_hits[item.first] += item.second;
+    pending_hits.clear();
+}
+
+//  committed values loaded by warmup(), at() takes them from here
+//  instead of going to the file
+template <typename T_key>
+class warm_cache
+{
+public:
+    warm_cache()
+        : stopping(false)
+    {}
+    ~warm_cache()
+    {
+        stop();
+    }
+
+    void wait() noexcept
+    {
+        for (auto& task : tasks)
+            task.wait();
+        tasks.clear();
+    }
+
+    void stop() noexcept
+    {
+        stopping = true;
+        wait();
+        stopping = false;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        items.clear();
+    }
+
+    bool take(T_key const& key, beltpp::packet& value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = items.find(key);
+        if (it == items.end())
+            return false;
+
+        value = std::move(it->second);
+        items.erase(it);
+        return true;
+    }
+
+    void erase(T_key const& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        items.erase(key);
+    }
+
+    std::atomic<bool> stopping;
+    std::mutex mutex;
+    unordered_map<T_key, beltpp::packet> items;
+    vector<std::future<void>> tasks;
+};
+
+template <typename T_key,
+          typename BlockItemType>
+class warmup_task
+{
+public:
+    vector<boost::filesystem::path> files;
+    bool load_values;
+    loader_stats_counters* pstats;
+    warm_cache<T_key>* pcache;
+
+    void operator()() const
+    {
+        //  the container's utl is not shared with other threads
+        auto ptr_utl = meshpp::detail::get_putl();
+
+        for (auto const& path : files)
+        {
+            if (pcache->stopping)
+                break;
+
+            try
+            {
+                if (false == load_values)
+                {
+                    //  markers are read on every load, so warming them
+                    //  up means bringing them to the system file cache
+                    auto path_marker = path;
+                    path_marker += ".m";
+
+                    std::istreambuf_iterator<char> end, begin;
+                    boost::filesystem::ifstream fl;
+                    load_file(path_marker, fl, begin, end);
+                    if (fl)
+                        stats_add(pstats, &loader_stats_counters::files_opened, 1);
+
+                    vector<char> buf_markers(begin, end);
+                    stats_add(pstats, &loader_stats_counters::bytes_read, buf_markers.size());
+                    continue;
+                }
+
+                block_file_loader<T_key,
+                                  BlockItemType,
+                                  &BlockItemType::from_string,
+                                  &BlockItemType::to_string>
+                        temp(path,
+                             vector<T_key>(),
+                             ptr_utl.get(),
+                             detail::null_ptr_transaction(),
+                             false,
+                             pstats);
+
+                unordered_set<T_key> keys;
+                temp.loaded(keys);
+
+                unordered_map<T_key, beltpp::packet> items;
+                for (auto const& key : keys)
+                    items[key] = std::move(temp[key].item);
+
+                std::lock_guard<std::mutex> lock(pcache->mutex);
+                for (auto& item : items)
+                    pcache->items.insert(std::make_pair(item.first, std::move(item.second)));
+            }
+            catch (...)
+            {
+                //  warmup is best effort
+            }
+        }
+    }
+};
+
+template <typename T_key,
+          typename BlockItemType>
+void start_warmup(warm_cache<T_key>& cache,
+                  vector<string> filenames,
+                  string const& name,
+                  boost::filesystem::path const& dir_path,
+                  warmup_policy const& policy,
+                  loader_stats_counters* pstats)
+{
+    if (policy.load_values && 0 == policy.hottest)
+        throw std::runtime_error("warmup(): load_values needs a hottest limit: " + name);
+
+    cache.stop();
+
+    if (policy.hottest)
+    {
+        auto hits = load_file_hits(name, dir_path);
+        auto count = [&hits](string const& filename)
+        {
+            auto it = hits.find(filename);
+            return it == hits.end() ? uint64_t(0) : it->second;
+        };
+        std::stable_sort(filenames.begin(), filenames.end(),
+                         [&count](string const& first, string const& second)
+        {
+            return count(first) > count(second);
+        });
+
+        if (filenames.size() > policy.hottest)
+            filenames.resize(policy.hottest);
+    }
+
+    size_t threads = std::max(size_t(1), policy.threads);
+    vector<warmup_task<T_key, BlockItemType>> tasks(std::min(threads, filenames.size()));
+
+    for (size_t index = 0; index < filenames.size(); ++index)
+    {
+        boost::filesystem::path path = dir_path / filenames[index];
+        if (false == boost::filesystem::exists(path))
+            continue;
+
+        tasks[index % tasks.size()].files.push_back(path);
+    }
+
+    for (auto& task : tasks)
+    {
+        if (task.files.empty())
+            continue;
+
+        task.load_values = policy.load_values;
+        task.pstats = pstats;
+        task.pcache = &cache;
+
+        cache.tasks.push_back(std::async(std::launch::async, task));
+    }
+}
+
 class map_loader_internals_impl
 {
 public:
     map_loader_internals_impl()
     : ptransaction(detail::null_ptr_transaction())
+    , stats()
+    , compression(value_compression::none)
     {}
     ptr_transaction ptransaction;
+    loader_stats_counters stats;
+    value_compression compression;
+    warm_cache<string> warm;
+    bool track_hits = false;
+    unordered_map<string, uint64_t> file_hits;
+    unordered_map<string, uint64_t> pending_hits;
 };
 
 unordered_set<string> keys(unordered_map<string, string> const& index)
@@ -1004,6 +1489,19 @@ map_loader_internals::~map_loader_internals() = default;
 
 void map_loader_internals::load(string const& key) const
 {
+    if (pimpl->track_hits)
+        ++pimpl->file_hits[filename(key, name, limit)];
+
+    {
+        beltpp::packet value;
+        if (pimpl->warm.take(key, value))
+        {
+            overlay[key] = std::make_pair(std::move(value),
+                                          map_loader_internals::none);
+            return;
+        }
+    }
+
     ptr_transaction item_ptransaction = detail::null_ptr_transaction();
 
     beltpp::finally guard1;
@@ -1039,7 +1537,9 @@ void map_loader_internals::load(string const& key) const
             temp(dir_path / filename(key, name, limit),
                  vector<string>{key},
                  ptr_utl.get(),
-                 std::move(item_ptransaction));
+                 std::move(item_ptransaction),
+                 false,
+                 &pimpl->stats);
 
     //  make sure guard2 will take the transaction back eventually
     //  for guard1 to be able to do it's job
@@ -1170,7 +1670,9 @@ void file_saver_helper(unordered_map<string, vector<value_type>> const& file_nam
                              file_keys,
                              pthis->ptr_utl.get(),
                              std::move(ref_ptransaction),
-                             i == e_op_erase);
+                             i == e_op_erase,
+                             &pthis->pimpl->stats,
+                             pthis->pimpl->compression);
 
                 //  make sure guard_item will take the transaction back eventually
                 //  in the end of this for step
@@ -1221,7 +1723,8 @@ void map_loader_internals::save()
 {
     auto ptr_utl_local = meshpp::detail::get_putl();
 
-    if (overlay.empty())
+    //  read only use still has access counts to write
+    if (overlay.empty() && pimpl->file_hits.empty())
         return;
 
     beltpp::on_failure guard([this]
@@ -1236,6 +1739,10 @@ void map_loader_internals::save()
     class_transaction& ref_class_transaction =
             dynamic_cast<class_transaction&>(*pimpl->ptransaction.get());
 
+    //  files are about to change, cached values of the keys
+    //  being written are not valid anymore
+    pimpl->warm.wait();
+
     vector<string> modified_keys;
     vector<string> erased_keys;
     for (auto& item : overlay)
@@ -1244,6 +1751,10 @@ void map_loader_internals::save()
             modified_keys.push_back(item.first);
         else if (item.second.second == map_loader_internals::deleted)
             erased_keys.push_back(item.first);
+        else
+            continue;
+
+        pimpl->warm.erase(item.first);
     }
 
     vector<vector<string>> all_keys = {std::move(erased_keys),
@@ -1263,7 +1774,9 @@ void map_loader_internals::save()
                 index_bl(dir_path / (name + ".index"),
                          group_keys,
                          ptr_utl_local.get(),
-                         std::move(ref_ptransaction_index));
+                         std::move(ref_ptransaction_index),
+                         false,
+                         &pimpl->stats);
         //  make sure guard_index will take the transaction back eventually
         //  in the end of this for step
         //  thus "index_bl" will be destructed without owning a transaction
@@ -1333,6 +1846,14 @@ void map_loader_internals::save()
                  i);
     }
 
+    save_file_hits(name,
+                   dir_path,
+                   pimpl->file_hits,
+                   pimpl->pending_hits,
+                   ref_class_transaction,
+                   ptr_utl_local.get(),
+                   &pimpl->stats);
+
     overlay.clear();
 
     guard.dismiss();
@@ -1342,9 +1863,14 @@ void map_loader_internals::discard() noexcept
 {
     if (pimpl && pimpl->ptransaction)
     {
+        stats_add(&pimpl->stats, &loader_stats_counters::rollback_count, 1);
+        stats_timer timer(&pimpl->stats, &loader_stats_counters::rollback_time);
+
         pimpl->ptransaction->rollback();
         pimpl->ptransaction = detail::null_ptr_transaction();
         index = index_to_rollback;
+
+        restore_file_hits(pimpl->file_hits, pimpl->pending_hits);
     }
     else
     {
@@ -1361,12 +1887,72 @@ void map_loader_internals::commit() noexcept
 {
     if (pimpl && pimpl->ptransaction)
     {
+        stats_add(&pimpl->stats, &loader_stats_counters::commit_count, 1);
+        stats_timer timer(&pimpl->stats, &loader_stats_counters::commit_time);
+
         pimpl->ptransaction->commit();
         pimpl->ptransaction = detail::null_ptr_transaction();
         index_to_rollback = index;
+
+        pimpl->pending_hits.clear();
     }
 }
 
+void map_loader_internals::warmup(warmup_policy const& policy)
+{
+    //  the cache is kept valid by save(), which drops the keys it writes
+    //  values loaded during a pending transaction would be stale after commit
+    if (pimpl->ptransaction)
+        throw std::runtime_error("warmup(): pending transaction on: " + name);
+
+    vector<string> filenames;
+    for (size_t index = 0; index < limit; ++index)
+        filenames.push_back(bucket_filename(name, index));
+
+    start_warmup<string, Data::StringBlockItem>(pimpl->warm,
+                                                std::move(filenames),
+                                                name,
+                                                dir_path,
+                                                policy,
+                                                &pimpl->stats);
+}
+
+void map_loader_internals::set_compression(value_compression compression) noexcept
+{
+    if (pimpl)
+        pimpl->compression = compression;
+}
+
+void map_loader_internals::enable_hit_tracking(bool enable) noexcept
+{
+    if (nullptr == pimpl)
+        return;
+
+    pimpl->track_hits = enable;
+    if (false == enable)
+        pimpl->file_hits.clear();
+}
+
+void map_loader_internals::enable_stats(bool enable) noexcept
+{
+    if (pimpl)
+        pimpl->stats.enabled = enable;
+}
+
+loader_stats map_loader_internals::stats() const noexcept
+{
+    if (nullptr == pimpl)
+        return loader_stats();
+
+    return pimpl->stats.snapshot();
+}
+
+void map_loader_internals::reset_stats() noexcept
+{
+    if (pimpl)
+        pimpl->stats.reset();
+}
+
 string map_loader_internals::filename(string const& key,
                                       string const& name,
                                       size_t limit)
@@ -1375,11 +1961,7 @@ string map_loader_internals::filename(string const& key,
     std::hash<string> hasher;
     size_t h = hasher(key) % limit;
 
-    string strh = std::to_string(h);
-    while (strh.length() < 4)
-        strh = "0" + strh;
-
-    return name + "." + strh;
+    return bucket_filename(name, h);
 }
 
 size_t load_size(string const& name,
@@ -1421,8 +2003,93 @@ class vector_loader_internals_impl
 public:
     vector_loader_internals_impl()
     : ptransaction(detail::null_ptr_transaction())
+    , stats()
+    , compression(value_compression::none)
+    , read_ahead(0)
+    , last_index(size_t(-1))
     {}
+    ~vector_loader_internals_impl()
+    {
+        stop_prefetch();
+    }
+
+    //  prefetch tasks read the committed files, so they must be
+    //  finished and forgotten before those files are touched
+    void stop_prefetch() noexcept
+    {
+        for (auto& task : prefetch_tasks)
+            task.wait();
+        prefetch_tasks.clear();
+
+        std::lock_guard<std::mutex> lock(prefetch_mutex);
+        prefetch_groups.clear();
+        prefetched.clear();
+    }
+
     ptr_transaction ptransaction;
+    loader_stats_counters stats;
+    value_compression compression;
+
+    size_t read_ahead;
+    size_t last_index;
+    std::mutex prefetch_mutex;
+    //  group numbers scheduled for prefetch and the values
+    //  loaded for those so far
+    unordered_set<size_t> prefetch_groups;
+    unordered_map<size_t, unordered_map<uint64_t, beltpp::packet>> prefetched;
+    vector<std::future<void>> prefetch_tasks;
+
+    warm_cache<uint64_t> warm;
+    bool track_hits = false;
+    unordered_map<string, uint64_t> file_hits;
+    unordered_map<string, uint64_t> pending_hits;
+};
+
+class vector_prefetch_task
+{
+public:
+    boost::filesystem::path path;
+    vector<uint64_t> keys;
+    size_t group_number;
+    vector_loader_internals_impl* pimpl;
+
+    void operator()() const
+    {
+        unordered_map<uint64_t, beltpp::packet> items;
+
+        try
+        {
+            //  the container's utl is not shared with other threads
+            auto ptr_utl = meshpp::detail::get_putl();
+
+            block_file_loader<uint64_t,
+                              Data::UInt64BlockItem,
+                              &Data::UInt64BlockItem::from_string,
+                              &Data::UInt64BlockItem::to_string>
+                    temp(path,
+                         keys,
+                         ptr_utl.get(),
+                         detail::null_ptr_transaction(),
+                         false,
+                         &pimpl->stats);
+
+            unordered_set<uint64_t> loaded_keys;
+            temp.loaded(loaded_keys);
+            for (auto const& key : loaded_keys)
+                items[key] = std::move(temp[key].item);
+        }
+        catch (...)
+        {
+            //  read ahead is best effort, load() will
+            //  do the job and report the error if any
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(pimpl->prefetch_mutex);
+        //  the group could be dropped while loading
+        if (pimpl->prefetch_groups.count(group_number))
+            pimpl->prefetched[group_number] = std::move(items);
+    }
 };
 
 vector_loader_internals::vector_loader_internals(string const& name,
@@ -1447,6 +2114,97 @@ vector_loader_internals::~vector_loader_internals() = default;
 
 void vector_loader_internals::load(size_t index) const
 {
+    if (pimpl->track_hits)
+        ++pimpl->file_hits[filename(index, name, limit, group)];
+
+    {
+        beltpp::packet value;
+        if (pimpl->warm.take(index, value))
+        {
+            overlay[index] = std::make_pair(std::move(value),
+                                            vector_loader_internals::none);
+            return;
+        }
+    }
+
+    //  prefetched values are read from committed files only
+    if (pimpl->read_ahead && nullptr == pimpl->ptransaction)
+    {
+        size_t current_group = index / group;
+        vector<size_t> groups_to_load;
+
+        bool sequential = (index == pimpl->last_index + 1);
+        pimpl->last_index = index;
+
+        std::unique_lock<std::mutex> lock(pimpl->prefetch_mutex);
+
+        if (sequential)
+        {
+            auto it_group = pimpl->prefetch_groups.begin();
+            while (it_group != pimpl->prefetch_groups.end())
+            {
+                if (*it_group < current_group)
+                {
+                    pimpl->prefetched.erase(*it_group);
+                    it_group = pimpl->prefetch_groups.erase(it_group);
+                }
+                else
+                    ++it_group;
+            }
+
+            for (size_t group_number = current_group + 1;
+                 group_number <= current_group + pimpl->read_ahead &&
+                 group_number * group < size;
+                 ++group_number)
+            {
+                if (pimpl->prefetch_groups.insert(group_number).second)
+                    groups_to_load.push_back(group_number);
+            }
+        }
+
+        bool found = false;
+        auto it_prefetched = pimpl->prefetched.find(current_group);
+        if (it_prefetched != pimpl->prefetched.end())
+        {
+            auto it_item = it_prefetched->second.find(index);
+            if (it_item != it_prefetched->second.end())
+            {
+                overlay[index] = std::make_pair(std::move(it_item->second),
+                                                vector_loader_internals::none);
+                it_prefetched->second.erase(it_item);
+                found = true;
+            }
+        }
+
+        lock.unlock();
+
+        auto it_task = pimpl->prefetch_tasks.begin();
+        while (it_task != pimpl->prefetch_tasks.end())
+        {
+            if (std::future_status::ready == it_task->wait_for(std::chrono::seconds(0)))
+                it_task = pimpl->prefetch_tasks.erase(it_task);
+            else
+                ++it_task;
+        }
+
+        for (size_t group_number : groups_to_load)
+        {
+            vector_prefetch_task task;
+            task.path = dir_path / filename(group_number * group, name, limit, group);
+            for (size_t key = group_number * group;
+                 key < (group_number + 1) * group && key < size;
+                 ++key)
+                task.keys.push_back(key);
+            task.group_number = group_number;
+            task.pimpl = pimpl.get();
+
+            pimpl->prefetch_tasks.push_back(std::async(std::launch::async, task));
+        }
+
+        if (found)
+            return;
+    }
+
     ptr_transaction item_ptransaction = detail::null_ptr_transaction();
     beltpp::finally guard1;
 
@@ -1473,7 +2231,9 @@ void vector_loader_internals::load(size_t index) const
             temp(dir_path / filename(index, name, limit, group),
                  vector<uint64_t>{index},
                  ptr_utl.get(),
-                 std::move(item_ptransaction));
+                 std::move(item_ptransaction),
+                 false,
+                 &pimpl->stats);
 
     beltpp::finally guard2([&item_ptransaction, &temp]
     {
@@ -1487,9 +2247,14 @@ void vector_loader_internals::load(size_t index) const
 void vector_loader_internals::save()
 {
     auto ptr_utl_local = meshpp::detail::get_putl();
-    if (overlay.empty())
+    //  read only use still has access counts to write
+    if (overlay.empty() && pimpl->file_hits.empty())
         return;
 
+    bool values_changed = (false == overlay.empty());
+
+    pimpl->stop_prefetch();
+
     beltpp::on_failure guard([this]
     {
         discard();
@@ -1502,6 +2267,8 @@ void vector_loader_internals::save()
     class_transaction& ref_class_transaction =
             dynamic_cast<class_transaction&>(*pimpl->ptransaction.get());
 
+    pimpl->warm.wait();
+
     vector<uint64_t> modified_keys;
     vector<uint64_t> erased_keys;
     for (auto& item : overlay)
@@ -1510,6 +2277,10 @@ void vector_loader_internals::save()
             modified_keys.push_back(item.first);
         else if (item.second.second == vector_loader_internals::deleted)
             erased_keys.push_back(item.first);
+        else
+            continue;
+
+        pimpl->warm.erase(item.first);
     }
 
     enum e_op {e_op_erase = 0, e_op_modify = 1};
@@ -1566,8 +2337,22 @@ void vector_loader_internals::save()
                  i);
     }
 
+    save_file_hits(name,
+                   dir_path,
+                   pimpl->file_hits,
+                   pimpl->pending_hits,
+                   ref_class_transaction,
+                   ptr_utl_local.get(),
+                   &pimpl->stats);
+
     overlay.clear();
 
+    if (false == values_changed)
+    {
+        guard.dismiss();
+        return;
+    }
+
     auto& ref_ptransaction_size = ref_class_transaction.size;
     using size_loader = block_file_loader<uint64_t,
                                           Data::UInt64BlockItem,
@@ -1578,7 +2363,9 @@ void vector_loader_internals::save()
             temp(dir_path / (name + ".size"),
                  vector<uint64_t>{0},
                  ptr_utl_local.get(),
-                 std::move(ref_ptransaction_size));
+                 std::move(ref_ptransaction_size),
+                 false,
+                 &pimpl->stats);
 
     beltpp::finally guard_size([&ref_ptransaction_size, &temp]
     {
@@ -1597,10 +2384,18 @@ void vector_loader_internals::save()
 
 void vector_loader_internals::discard() noexcept
 {
+    if (pimpl)
+        pimpl->stop_prefetch();
+
     if (pimpl && pimpl->ptransaction)
     {
+        stats_add(&pimpl->stats, &loader_stats_counters::rollback_count, 1);
+        stats_timer timer(&pimpl->stats, &loader_stats_counters::rollback_time);
+
         pimpl->ptransaction->rollback();
         pimpl->ptransaction = detail::null_ptr_transaction();
+
+        restore_file_hits(pimpl->file_hits, pimpl->pending_hits);
     }
 
     overlay.clear();
@@ -1612,11 +2407,81 @@ void vector_loader_internals::commit() noexcept
 {
     if (pimpl && pimpl->ptransaction)
     {
+        pimpl->stop_prefetch();
+
+        stats_add(&pimpl->stats, &loader_stats_counters::commit_count, 1);
+        stats_timer timer(&pimpl->stats, &loader_stats_counters::commit_time);
+
         pimpl->ptransaction->commit();
         pimpl->ptransaction = detail::null_ptr_transaction();
+
+        pimpl->pending_hits.clear();
     }
 }
 
+void vector_loader_internals::warmup(warmup_policy const& policy)
+{
+    //  the cache is kept valid by save(), which drops the keys it writes
+    //  values loaded during a pending transaction would be stale after commit
+    if (pimpl->ptransaction)
+        throw std::runtime_error("warmup(): pending transaction on: " + name);
+
+    vector<string> filenames;
+    size_t file_count = std::min(limit, (size + group - 1) / group);
+    for (size_t index = 0; index < file_count; ++index)
+        filenames.push_back(bucket_filename(name, index));
+
+    start_warmup<uint64_t, Data::UInt64BlockItem>(pimpl->warm,
+                                                  std::move(filenames),
+                                                  name,
+                                                  dir_path,
+                                                  policy,
+                                                  &pimpl->stats);
+}
+
+void vector_loader_internals::set_read_ahead(size_t groups)
+{
+    pimpl->stop_prefetch();
+    pimpl->read_ahead = groups;
+    pimpl->last_index = size_t(-1);
+}
+
+void vector_loader_internals::set_compression(value_compression compression) noexcept
+{
+    if (pimpl)
+        pimpl->compression = compression;
+}
+
+void vector_loader_internals::enable_hit_tracking(bool enable) noexcept
+{
+    if (nullptr == pimpl)
+        return;
+
+    pimpl->track_hits = enable;
+    if (false == enable)
+        pimpl->file_hits.clear();
+}
+
+void vector_loader_internals::enable_stats(bool enable) noexcept
+{
+    if (pimpl)
+        pimpl->stats.enabled = enable;
+}
+
+loader_stats vector_loader_internals::stats() const noexcept
+{
+    if (nullptr == pimpl)
+        return loader_stats();
+
+    return pimpl->stats.snapshot();
+}
+
+void vector_loader_internals::reset_stats() noexcept
+{
+    if (pimpl)
+        pimpl->stats.reset();
+}
+
 string vector_loader_internals::filename(size_t index,
                                          string const& name,
                                          size_t limit,
@@ -1624,11 +2489,8 @@ string vector_loader_internals::filename(size_t index,
 {
     assert(group > 0);
     assert(limit > 0);
-    string strh = std::to_string((index / group) % limit);
-    while (strh.length() < 4)
-        strh = "0" + strh;
 
-    return name + "." + strh;
+    return bucket_filename(name, (index / group) % limit);
 }
 
 
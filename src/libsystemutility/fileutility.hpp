@@ -11,6 +11,7 @@
 #include <boost/system/error_code.hpp>
 
 #include <memory>
+#include <chrono>
 #include <exception>
 #include <stdexcept>
 #include <iterator>
@@ -353,6 +354,41 @@ private:
     std::unique_ptr<T> ptr;
 };
 
+//  snapshot of the counters a map_loader or vector_loader collects
+//  while stats are enabled, see enable_stats()
+class loader_stats
+{
+public:
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+    uint64_t files_opened = 0;
+    uint64_t copy_file_bytes = 0;
+    uint64_t compaction_bytes_moved = 0;
+    uint64_t commit_count = 0;
+    uint64_t rollback_count = 0;
+    std::chrono::nanoseconds parse_time = std::chrono::nanoseconds::zero();
+    std::chrono::nanoseconds serialize_time = std::chrono::nanoseconds::zero();
+    std::chrono::nanoseconds commit_time = std::chrono::nanoseconds::zero();
+    std::chrono::nanoseconds rollback_time = std::chrono::nanoseconds::zero();
+};
+
+//  compression applied to values when they are written,
+//  records are marked individually, so files may contain both kinds
+enum class value_compression {none, zlib};
+
+//  which bucket files warmup() reads and how much of each
+class warmup_policy
+{
+public:
+    //  read values into a cache consumed by at(),
+    //  otherwise only the marker tables are read
+    bool load_values = false;
+    //  number of most accessed bucket files, 0 means all of them.
+    //  must be set with load_values, to keep the memory bounded
+    size_t hottest = 0;
+    size_t threads = 4;
+};
+
 namespace detail
 {
 class map_loader_internals_impl;
@@ -420,6 +456,14 @@ public:
     void discard() noexcept;
     void commit() noexcept;
 
+    void warmup(warmup_policy const& policy);
+    void enable_hit_tracking(bool enable) noexcept;
+    void set_compression(value_compression compression) noexcept;
+
+    void enable_stats(bool enable) noexcept;
+    loader_stats stats() const noexcept;
+    void reset_stats() noexcept;
+
     static std::string filename(std::string const& key,
                                 std::string const& name,
                                 size_t limit);
@@ -634,6 +678,46 @@ public:
         data.commit();
     }
 
+    //  starts loading bucket files on background threads, so that
+    //  first accesses after a restart don't pay the cold file cost.
+    //  the hottest files are picked by the counts of enable_hit_tracking()
+    void warmup(warmup_policy const& policy)
+    {
+        data.warmup(policy);
+    }
+
+    //  counts bucket file accesses, save() adds them to name.hits
+    //  within the same transaction as the values, also when no value
+    //  was changed. counts of a discarded transaction are saved again
+    void enable_hit_tracking(bool enable) noexcept
+    {
+        data.enable_hit_tracking(enable);
+    }
+
+    //  affects values written by the following save() calls,
+    //  values are read back regardless of this setting
+    void set_compression(value_compression compression) noexcept
+    {
+        data.set_compression(compression);
+    }
+
+    //  counters are not collected until enabled, so that
+    //  the disabled case costs a single flag check
+    void enable_stats(bool enable) noexcept
+    {
+        data.enable_stats(enable);
+    }
+
+    loader_stats stats() const noexcept
+    {
+        return data.stats();
+    }
+
+    void reset_stats() noexcept
+    {
+        data.reset_stats();
+    }
+
     map_loader const& as_const() const { return *this; }
 private:
     mutable internal data;
@@ -708,6 +792,16 @@ public:
     void discard() noexcept;
     void commit() noexcept;
 
+    void warmup(warmup_policy const& policy);
+    void enable_hit_tracking(bool enable) noexcept;
+    void set_compression(value_compression compression) noexcept;
+
+    void set_read_ahead(size_t groups);
+
+    void enable_stats(bool enable) noexcept;
+    loader_stats stats() const noexcept;
+    void reset_stats() noexcept;
+
     static std::string filename(size_t index,
                                 std::string const& name,
                                 size_t limit,
@@ -874,6 +968,44 @@ public:
         data.commit();
     }
 
+    //  when sequential access is detected, load up to "groups"
+    //  following group files on a background thread, 0 disables
+    void set_read_ahead(size_t groups)
+    {
+        data.set_read_ahead(groups);
+    }
+
+    //  same as map_loader::warmup()
+    void warmup(warmup_policy const& policy)
+    {
+        data.warmup(policy);
+    }
+
+    void enable_hit_tracking(bool enable) noexcept
+    {
+        data.enable_hit_tracking(enable);
+    }
+
+    void set_compression(value_compression compression) noexcept
+    {
+        data.set_compression(compression);
+    }
+
+    void enable_stats(bool enable) noexcept
+    {
+        data.enable_stats(enable);
+    }
+
+    loader_stats stats() const noexcept
+    {
+        return data.stats();
+    }
+
+    void reset_stats() noexcept
+    {
+        data.reset_stats();
+    }
+
     vector_loader const& as_const() const { return *this; }
 private:
     mutable internal data;
@@ -5,7 +5,12 @@
 
 #include <mesh.pp/fileutility.hpp>
 
+#include <boost/filesystem.hpp>
+
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 #include <unordered_set>
 
 using std::string;
@@ -14,6 +19,8 @@ using std::cout;
 using std::cin;
 using std::endl;
 
+namespace filesystem = boost::filesystem;
+
 using namespace test_containers;
 
 
@@ -29,6 +36,74 @@ beltpp::void_unique_ptr get_putl()
     return ptr_utl;
 }
 
+void check(bool value, string const& what)
+{
+    if (false == value)
+        throw std::runtime_error("check failed: " + what);
+}
+
+string read_file(filesystem::path const& path)
+{
+    std::ifstream fl(path.string(), std::ios_base::binary);
+    return string(std::istreambuf_iterator<char>(fl),
+                  std::istreambuf_iterator<char>());
+}
+
+//  compressed and plain records are read back the same, whatever
+//  the compression setting of the reader is
+void test_compression(filesystem::path const& path)
+{
+    string long_value(4096, 'a');
+    for (size_t index = 0; index < long_value.size(); index += 7)
+        long_value[index] = 'b';
+    //  zlib does not make this one shorter, it is kept as is
+    string short_value = "tiny value";
+
+    {
+        meshpp::map_loader<Text> map("compressed", path, 1, get_putl());
+        map.set_compression(meshpp::value_compression::zlib);
+
+        Text item;
+        item.value = long_value;
+        map.insert("large", item);
+        item.value = short_value;
+        map.insert("small", item);
+
+        map.save();
+        map.commit();
+    }
+
+    string contents = read_file(path / "compressed.0000");
+    check(contents.find(long_value) == string::npos, "long value is written compressed");
+    check(contents.find("\"" + short_value + "\"") != string::npos, "short value is written as is");
+    check(contents.size() < long_value.size(), "bucket file is smaller than the long value");
+
+    {
+        meshpp::map_loader<Text> map("compressed", path, 1, get_putl());
+        check(map.as_const().at("large").value == long_value, "long value round trip");
+        check(map.as_const().at("small").value == short_value, "short value round trip");
+
+        Text item;
+        item.value = long_value + "c";
+        map.insert("plain", item);
+
+        map.save();
+        map.commit();
+    }
+
+    check(read_file(path / "compressed.0000").find(long_value + "c") != string::npos,
+          "value is written as is without compression");
+
+    {
+        meshpp::map_loader<Text> map("compressed", path, 1, get_putl());
+        map.set_compression(meshpp::value_compression::zlib);
+
+        check(map.as_const().at("large").value == long_value, "long value read with compression on");
+        check(map.as_const().at("small").value == short_value, "short value read with compression on");
+        check(map.as_const().at("plain").value == long_value + "c", "plain value read with compression on");
+    }
+}
+
 int main(int argc, char* argv[])
 {
     B_UNUSED(argc);
@@ -36,14 +111,29 @@ int main(int argc, char* argv[])
 
     try
     {
-        meshpp::map_loader<Value> map("map", "/Users/tigran/publiq.pp1/map", 100, get_putl());
+        filesystem::path path = filesystem::temp_directory_path() /
+                                filesystem::unique_path("test_containers-%%%%-%%%%");
+        filesystem::create_directories(path);
+        beltpp::finally guard([&path]
+        {
+            boost::system::error_code ec;
+            filesystem::remove_all(path, ec);
+        });
+
+        meshpp::map_loader<Value> map("map", path, 100, get_putl());
         Value v;
         v.num = 0;
+        map.insert("0", v);
+        map.insert("1", v);
         map.at("0").num = 30;
         map.at("1").num = 20;
         map.insert("2", v);
         map.save();
         map.commit();
+
+        test_compression(path);
+
+        cout << "all checks passed" << endl;
     }
     catch(std::exception const& ex)
     {
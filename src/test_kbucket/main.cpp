@@ -0,0 +1,187 @@
+#include <belt.pp/global.hpp>
+
+#include <kbucket/konnection.hpp>
+#include <kbucket/kbucket.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+void check(bool value, string const& what)
+{
+    if (false == value)
+        throw std::runtime_error("check failed: " + what);
+}
+
+vector<Konnection> make_konnections(string const& prefix, size_t count)
+{
+    vector<Konnection> result;
+    for (size_t index = 0; index < count; ++index)
+        result.push_back(Konnection(prefix + std::to_string(index),
+                                    "peer " + prefix + std::to_string(index)));
+    return result;
+}
+
+//  the result is the same as sorting all contacts by distance
+void test_list_nearests_to()
+{
+    Konnection self("self");
+    KBucket<Konnection> kbucket(self);
+
+    for (auto const& item : make_konnections("node", 500))
+        kbucket.insert(item);
+
+    vector<Konnection> all(kbucket.begin(), kbucket.end());
+    check(all.size() > 20, "enough contacts to choose from");
+
+    for (auto const& target : make_konnections("target", 10))
+    {
+        vector<Konnection> expected = all;
+        std::sort(expected.begin(), expected.end(),
+                  [&target](Konnection const& a, Konnection const& b)
+                  {
+                      return a.distance_from(target) < b.distance_from(target);
+                  });
+
+        auto nearest = kbucket.list_nearests_to(target);
+        check(nearest.size() == 20, "K contacts by default");
+        for (size_t index = 0; index < nearest.size(); ++index)
+            check(nearest[index].get_id() == expected[index].get_id(),
+                  "closest first for " + target.get_id());
+
+        auto limited = kbucket.list_nearests_to(target, 3);
+        check(limited.size() == 3, "count is respected");
+        for (size_t index = 0; index < limited.size(); ++index)
+            check(limited[index].get_id() == expected[index].get_id(),
+                  "limited list is a prefix of the full one");
+
+        auto everything = kbucket.list_nearests_to(target, all.size() + 10);
+        check(everything.size() == all.size(), "no more than the contacts");
+    }
+
+    //  a known contact is the closest to itself
+    auto nearest = kbucket.list_nearests_to(all.front());
+    check(false == nearest.empty() &&
+          nearest.front().get_id() == all.front().get_id(),
+          "contact is the closest to itself");
+
+    KBucket<Konnection> empty(self);
+    check(empty.list_nearests_to(self).empty(), "empty kbucket lists nothing");
+}
+
+//  contacts that all fall in the same bucket of self
+vector<Konnection> same_bucket(Konnection const& self, size_t count)
+{
+    vector<Konnection> result;
+    for (size_t index = 0; result.size() < count; ++index)
+    {
+        Konnection item("node" + std::to_string(index),
+                        "peer" + std::to_string(index));
+        //  the farthest bucket takes about half of all nodeids
+        if (bucket_index(self.distance_from(item)) == KBucket<Konnection>::LEVELS - 1)
+            result.push_back(item);
+    }
+    return result;
+}
+
+void test_replacements()
+{
+    Konnection self("self");
+    KBucket<Konnection, 4> kbucket(self);
+    auto nodes = same_bucket(self, 12);
+
+    for (size_t index = 0; index < 4; ++index)
+        check(kbucket.insert(nodes[index]).second, "bucket has room");
+
+    //  full bucket points to its least recently seen contact
+    check(false == kbucket.has_room_for(nodes[4]), "bucket is full");
+    auto result = kbucket.insert(nodes[4]);
+    check(false == result.second, "full bucket refuses");
+    check(result.first->get_id() == nodes[0].get_id(), "least recently seen is the first");
+
+    check(kbucket.touch(nodes[0]), "touch a contact");
+    result = kbucket.insert(nodes[4]);
+    check(result.first->get_id() == nodes[1].get_id(), "touched one is not least recently seen");
+
+    check(kbucket.add_replacement(nodes[4]), "replacement is kept");
+    check(kbucket.add_replacement(nodes[5]), "second replacement is kept");
+    check(kbucket.is_replacement(nodes[4]), "is a replacement");
+    check(false == kbucket.is_replacement(nodes[1]), "contact is not a replacement");
+    check(false == kbucket.add_replacement(nodes[1]), "contact can't be a replacement");
+    check(kbucket.find(nodes[4]) == kbucket.end(), "replacement is not a contact");
+
+    //  touching a replacement makes it the most recently seen one
+    check(kbucket.touch(nodes[4]), "touch a replacement");
+
+    kbucket.erase(nodes[1]);
+    check(kbucket.find(nodes[1]) == kbucket.end(), "contact is erased");
+    check(kbucket.find(nodes[4]) != kbucket.end(), "latest replacement is promoted");
+    check(false == kbucket.is_replacement(nodes[4]), "promoted is not a replacement");
+    check(kbucket.is_replacement(nodes[5]), "other replacement waits");
+
+    auto promoted = kbucket.take_promoted();
+    check(promoted.size() == 1 && promoted.front().get_id() == nodes[4].get_id(),
+          "promotion is reported");
+    check(kbucket.take_promoted().empty(), "promotion is reported once");
+
+    //  promoted contact is the most recently seen, nodes[2] is the oldest
+    result = kbucket.insert(nodes[6]);
+    check(result.first->get_id() == nodes[2].get_id(), "promoted goes to the back");
+
+    //  the cache keeps the latest K
+    for (size_t index = 6; index < 10; ++index)
+        check(kbucket.add_replacement(nodes[index]), "replacement is kept");
+    check(false == kbucket.is_replacement(nodes[5]), "oldest replacement is dropped");
+    for (size_t index = 6; index < 10; ++index)
+        check(kbucket.is_replacement(nodes[index]), "latest replacements stay");
+
+    kbucket.erase(nodes[9]);
+    check(false == kbucket.is_replacement(nodes[9]), "replacement is erased");
+    check(kbucket.find(nodes[9]) == kbucket.end(), "erased replacement is not promoted");
+
+    //  range erase promotes replacements and keeps them
+    kbucket.erase(kbucket.begin(), kbucket.end());
+    size_t count = 0;
+    for (auto const& item : kbucket)
+    {
+        check(item.get_id() == nodes[6].get_id() ||
+              item.get_id() == nodes[7].get_id() ||
+              item.get_id() == nodes[8].get_id(),
+              "only promoted replacements are left");
+        ++count;
+    }
+    check(count == 3, "all replacements are promoted");
+    check(kbucket.take_promoted().size() == 3, "promotions are reported");
+}
+
+int main(int argc, char* argv[])
+{
+    B_UNUSED(argc);
+    B_UNUSED(argv);
+
+    try
+    {
+        test_list_nearests_to();
+        test_replacements();
+
+        cout << "all checks passed" << endl;
+    }
+    catch(std::exception const& ex)
+    {
+        cout << "exception: " << ex.what() << endl;
+        return -1;
+    }
+    catch(...)
+    {
+        cout << "too well done ...\nthat was an exception\n";
+        return -1;
+    }
+    return 0;
+}
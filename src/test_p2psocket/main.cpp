@@ -0,0 +1,307 @@
+#include <belt.pp/global.hpp>
+
+#include <libp2psocket/verification_queue.hpp>
+#include <libp2psocket/dial_tracker.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+
+namespace chrono = std::chrono;
+
+using queue_type = meshpp::detail::verification_queue<string>;
+
+void check(bool value, string const& what)
+{
+    if (false == value)
+        throw std::runtime_error("check failed: " + what);
+}
+
+//  stands for the event handler, counts the wake ups
+class waker
+{
+public:
+    void wake()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++count;
+        }
+        condition.notify_all();
+    }
+
+    bool wait_for(size_t expected, chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return condition.wait_for(lock, timeout, [&]{ return count >= expected; });
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    size_t count = 0;
+};
+
+//  checks of "slow" nodeids wait until released
+class gate
+{
+public:
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this]{ return open; });
+    }
+
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            open = true;
+        }
+        condition.notify_all();
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool open = false;
+};
+
+string joined(std::deque<string> const& items)
+{
+    string result;
+    for (auto const& item : items)
+        result += item + " ";
+    return result;
+}
+
+//  a slow peer's packets stay parked in order, while a fast peer's
+//  check finishes and is given back right away
+void test_slow_peer()
+{
+    waker events;
+    gate slow;
+
+    queue_type queue(2,
+                     16,
+                     [&slow](string const& nodeid, string const& message, string const&)
+                     {
+                         if (nodeid == "slow")
+                             slow.wait();
+                         return message != "bad";
+                     },
+                     [&events]{ events.wake(); });
+
+    check(queue.verify_later("a", true, "slow", "ping", "sig", "a0"), "slow check is queued");
+    check(queue.is_parked("a"), "slow peer is parked");
+    queue.park("a", "a1");
+    queue.park("a", "a2");
+
+    check(queue.verify_later("b", false, "fast", "pong", "sig", "b0"), "fast check is queued");
+    queue.park("b", "b1");
+
+    check(events.wait_for(1, chrono::seconds(5)), "fast check wakes the handler");
+
+    queue_type::result taken;
+    std::deque<string> items;
+    check(queue.take(taken, items), "fast check is done");
+    check(taken.peer == "b" && taken.nodeid == "fast", "fast peer is taken");
+    check(taken.verified && false == taken.ping, "fast pong is verified");
+    check(joined(items) == "b0 b1 ", "fast peer keeps its order: " + joined(items));
+    check(false == queue.is_parked("b"), "fast peer is not parked anymore");
+
+    check(false == queue.take(taken, items), "slow check is not done yet");
+    check(queue.is_parked("a"), "slow peer is still parked");
+    queue.park("a", "a3");
+
+    auto released = chrono::steady_clock::now();
+    slow.release();
+    check(events.wait_for(2, chrono::seconds(5)), "slow check wakes the handler");
+    check(chrono::steady_clock::now() - released < chrono::seconds(1),
+          "slow check is not delivered late");
+
+    check(queue.take(taken, items), "slow check is done");
+    check(taken.peer == "a" && taken.verified && taken.ping, "slow ping is verified");
+    check(joined(items) == "a0 a1 a2 a3 ", "slow peer keeps its order: " + joined(items));
+    check(queue.idle(), "nothing is left");
+}
+
+void test_failures()
+{
+    waker events;
+
+    queue_type queue(1,
+                     2,
+                     [](string const& nodeid, string const& message, string const&)
+                     {
+                         if (nodeid == "malformed")
+                             throw std::runtime_error("malformed nodeid");
+                         return message != "bad";
+                     },
+                     [&events]{ events.wake(); });
+
+    check(queue.verify_later("a", true, "node", "bad", "sig", "a0"), "bad check is queued");
+    check(queue.verify_later("b", true, "malformed", "ping", "sig", "b0"), "malformed check is queued");
+    check(queue.full(), "queue is full");
+    check(false == queue.verify_later("c", true, "node", "ping", "sig", "c0"),
+          "full queue leaves the check to the caller");
+    check(false == queue.is_parked("c"), "refused check parks nothing");
+
+    check(events.wait_for(2, chrono::seconds(5)), "both checks are done");
+
+    queue_type::result taken;
+    std::deque<string> items;
+    check(queue.take(taken, items), "bad check is taken");
+    check(taken.peer == "a" && false == taken.verified, "bad signature fails");
+    check(queue.take(taken, items), "malformed check is taken");
+    check(taken.peer == "b" && false == taken.verified, "throwing check fails");
+    check(false == queue.full(), "queue has room again");
+
+    //  a dropped peer's result is not given back
+    check(queue.verify_later("d", true, "node", "ping", "sig", "d0"), "check is queued");
+    queue.forget("d");
+    check(events.wait_for(3, chrono::seconds(5)), "check is done");
+    check(false == queue.take(taken, items), "forgotten peer is skipped");
+    check(queue.idle(), "nothing is left");
+}
+
+using dial_tracker = meshpp::detail::dial_tracker;
+using dial_clock = dial_tracker::clock;
+
+//  a failed address waits base * 2^(failures - 1), from half to one and
+//  a half of that, up to the max, and is let go after a success
+void test_dial_backoff()
+{
+    dial_tracker dials(16,
+                       chrono::seconds(30),
+                       chrono::seconds(1),
+                       chrono::seconds(300),
+                       12345);
+
+    auto now = dial_clock::now();
+    string key = "10.0.0.1:12000";
+
+    check(dials.allowed(key, now), "new address is allowed");
+
+    size_t expected = 1;
+    for (size_t failure = 1; failure <= 12; ++failure)
+    {
+        dials.started(key, vector<string>{"p" + std::to_string(failure)}, now);
+        check(false == dials.allowed(key, now), "address being dialed is not dialed again");
+
+        dials.failed("p" + std::to_string(failure), now);
+
+        auto lowest = chrono::milliseconds(expected * 1000 / 2);
+        auto highest = chrono::milliseconds(expected * 1000 * 3 / 2);
+        check(false == dials.allowed(key, now + lowest - chrono::milliseconds(1)),
+              "no retry before half of the delay, failure " + std::to_string(failure));
+        check(dials.allowed(key, now + highest),
+              "retry after one and a half of the delay, failure " + std::to_string(failure));
+
+        now += highest;
+        expected = std::min(expected * 2, size_t(300));
+    }
+
+    //  success forgets the failures
+    dials.started(key, vector<string>{"ok"}, now);
+    dials.succeeded("ok");
+    check(dials.allowed(key, now), "success clears the backoff");
+
+    dials.started(key, vector<string>{"again"}, now);
+    dials.failed("again", now);
+    check(dials.allowed(key, now + chrono::milliseconds(1500)), "backoff starts from the base again");
+
+    //  a success of one attempt drops the others to the same address
+    string other = "10.0.0.2:12000";
+    dials.started(other, vector<string>{"a", "b"}, now);
+    check(1 == dials.dialing(), "two attempts to one address count once");
+    dials.succeeded("b");
+    check(0 == dials.dialing(), "success ends all attempts to the address");
+    dials.failed("a", now);
+    check(dials.allowed(other, now), "late failure of a finished address is ignored");
+
+    //  only the last failed attempt to an address starts the backoff
+    dials.started(other, vector<string>{"c", "d"}, now);
+    dials.failed("c", now);
+    check(false == dials.allowed(other, now + chrono::seconds(10)), "still dialing the address");
+    dials.failed("d", now);
+    check(0 == dials.dialing(), "both attempts failed");
+    check(false == dials.allowed(other, now + chrono::milliseconds(499)), "address backs off");
+}
+
+void test_dial_limit()
+{
+    dial_tracker dials(3,
+                       chrono::seconds(30),
+                       chrono::seconds(1),
+                       chrono::seconds(300),
+                       12345);
+
+    auto now = dial_clock::now();
+    for (size_t index = 0; index < 3; ++index)
+    {
+        check(false == dials.at_limit(), "room for another dial");
+        dials.started("address" + std::to_string(index),
+                      vector<string>{"peer" + std::to_string(index)},
+                      now);
+    }
+    check(dials.at_limit(), "limit is reached");
+
+    dials.succeeded("peer0");
+    check(false == dials.at_limit(), "finished dial makes room");
+
+    dials.started("address3", vector<string>{"peer3"}, now + chrono::seconds(20));
+    check(dials.at_limit(), "limit is reached again");
+
+    //  unanswered dials time out and count as failed
+    dials.expire(now + chrono::seconds(30));
+    check(1 == dials.dialing(), "old dials time out, the newer one stays");
+    check(false == dials.allowed("address1", now + chrono::seconds(30)), "timed out address backs off");
+    check(dials.allowed("address0", now + chrono::seconds(30)), "succeeded address is allowed");
+
+    dials.expire(now + chrono::seconds(50));
+    check(0 == dials.dialing(), "last dial times out");
+
+    //  backoffs long over are forgotten, the next failure starts from the base
+    dials.expire(now + chrono::seconds(1000));
+    dials.started("address1", vector<string>{"peer4"}, now + chrono::seconds(1000));
+    dials.failed("peer4", now + chrono::seconds(1000));
+    check(dials.allowed("address1", now + chrono::seconds(1000) + chrono::milliseconds(1500)),
+          "old backoff is forgotten");
+}
+
+int main(int argc, char* argv[])
+{
+    B_UNUSED(argc);
+    B_UNUSED(argv);
+
+    try
+    {
+        test_slow_peer();
+        test_failures();
+        test_dial_backoff();
+        test_dial_limit();
+
+        cout << "all checks passed" << endl;
+    }
+    catch(std::exception const& ex)
+    {
+        cout << "exception: " << ex.what() << endl;
+        return -1;
+    }
+    catch(...)
+    {
+        cout << "too well done ...\nthat was an exception\n";
+        return -1;
+    }
+    return 0;
+}
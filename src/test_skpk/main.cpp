@@ -14,6 +14,104 @@
 #include <random>
 #include <string>
 #include <cassert>
+#include <vector>
+
+//  the per bit loop distance() used before distance_raw
+uint64_t distance_reference(meshpp::hash_digest const& first,
+                            meshpp::hash_digest const& second)
+{
+    auto setbitcount = [](unsigned char ch)
+    {
+        size_t res = 0;
+        unsigned char test = 1;
+        for (size_t index = 0; index < 8; ++index)
+        {
+            unsigned char temp = test & ch;
+            res += (0 != temp);
+            test *= 2;
+        }
+
+        return res;
+    };
+
+    uint32_t compress_int = 0;
+    for (uint32_t index = 0; index < 32; ++index)
+    {
+        unsigned char ch = first[index] ^ second[index];
+        uint32_t k = 6 - index / 8;
+        uint32_t temp = (k <= setbitcount(ch));
+
+        compress_int *= 2;
+        compress_int |= temp;
+    }
+
+    return compress_int;
+}
+
+bool test_distance_raw()
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> byte(0, 255);
+    //  mostly few bits set, so that all the thresholds are crossed
+    std::uniform_int_distribution<int> bit(0, 7);
+
+    auto random_digest = [&](bool sparse)
+    {
+        meshpp::hash_digest result;
+        for (auto& item : result)
+        {
+            if (sparse)
+                item = (unsigned char)((1 << bit(generator)) | (1 << bit(generator)));
+            else
+                item = (unsigned char)byte(generator);
+        }
+        return result;
+    };
+
+    meshpp::hash_digest first = random_digest(false);
+    std::vector<meshpp::hash_digest> others;
+    for (size_t index = 0; index < 2000; ++index)
+    {
+        meshpp::hash_digest other = random_digest(index % 2 == 0);
+        if (index % 3 == 0)
+        {
+            for (size_t position = 0; position < other.size(); ++position)
+                other[position] ^= first[position];
+        }
+        others.push_back(other);
+    }
+    others.push_back(first);
+
+    std::vector<uint64_t> batch = meshpp::distance_raw(first, others);
+    if (batch.size() != others.size())
+    {
+        std::cout << "distance_raw batch size mismatch" << std::endl;
+        return false;
+    }
+
+    for (size_t index = 0; index < others.size(); ++index)
+    {
+        uint64_t expected = distance_reference(first, others[index]);
+        if (meshpp::distance_raw(first, others[index]) != expected ||
+            batch[index] != expected)
+        {
+            std::cout << "distance_raw mismatch at " << index << std::endl;
+            return false;
+        }
+    }
+
+    std::string hash_first = meshpp::hash("first");
+    std::string hash_second = meshpp::hash("second");
+    if (meshpp::distance(hash_first, hash_second) !=
+        distance_reference(meshpp::hash_digest_from_base58(hash_first),
+                           meshpp::hash_digest_from_base58(hash_second)))
+    {
+        std::cout << "distance mismatch" << std::endl;
+        return false;
+    }
+
+    return true;
+}
 
 
 int main(int argc, char **argv)
@@ -91,6 +189,9 @@ int main(int argc, char **argv)
                 );
     std::cout << "imported_signature is verified since it's already constructed" << std::endl;
 
+    if (false == test_distance_raw())
+        return -1;
+    std::cout << "distance_raw matches the per bit distance" << std::endl;
 
     return 0;
 }